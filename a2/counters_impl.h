@@ -3,6 +3,16 @@
 
 #include <atomic>
 #include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include "numa_tools.h"
+#include <sched.h>
+#include <unistd.h>
+#if defined(__x86_64__) && __has_include(<sys/rseq.h>)
+#include <sys/rseq.h>
+#define COUNTER_HAVE_RSEQ
+#endif
 
 #define MAX_THREADS 256
 
@@ -70,14 +80,123 @@ struct padded_int64_t {
     volatile char padding[64-sizeof(atomic<int64_t>)];
 };
 
+// Growable slab of cache-line-padded per-thread slots.
+// Instead of reserving MAX_THREADS slots up front, a thread claims a slot the
+// first time it touches the counter and gives it back with release(), so memory
+// scales with the number of threads that are actually using the counter.
+// Slot must have an atomic<int> owner field (-1 when free).
+// Lookups go through a small per-thread direct-mapped cache keyed by a unique
+// slab id, so the common case is one thread-local load plus a check that the
+// cached slot is still ours; on a miss we scan the slab (O(active threads)).
+template <class Slot>
+class ThreadSlotSlab {
+private:
+    static const int SEGMENT_SLOTS = 8;
+    static const int CACHE_SIZE = 64;
+    struct Segment {
+        Slot slots[SEGMENT_SLOTS];
+        atomic<Segment *> next;
+        char padding[64];
+        Segment(int claimingTid) : next(nullptr) {
+            for (int i = 0; i < SEGMENT_SLOTS; ++i) slots[i].owner = -1;
+            slots[0].owner = claimingTid; // pre-claimed so we can't lose it after publishing the segment
+        }
+    };
+    struct CacheEntry {
+        int64_t slabId;
+        int tid;
+        Slot * slot;
+    };
+    inline static atomic<int64_t> nextSlabId {1};
+
+    char padding0[64];
+    const int64_t slabId;
+    atomic<Segment *> head;
+    char padding1[64];
+
+    static CacheEntry * getCache() {
+        static thread_local CacheEntry entries[CACHE_SIZE] = {};
+        return entries;
+    }
+
+    Slot * claim(int tid) {
+        // first: do we already own a slot? (our cache entry may have been evicted)
+        Slot * freeSlot = nullptr;
+        for (Segment * seg = head; seg; seg = seg->next) {
+            for (int i = 0; i < SEGMENT_SLOTS; ++i) {
+                int owner = seg->slots[i].owner;
+                if (owner == tid) return &seg->slots[i];
+                if (owner == -1 && !freeSlot) freeSlot = &seg->slots[i];
+            }
+        }
+        // next: try to grab a free slot
+        if (freeSlot) {
+            int expected = -1;
+            if (freeSlot->owner.compare_exchange_strong(expected, tid)) return freeSlot;
+        }
+        for (Segment * seg = head; seg; seg = seg->next) {
+            for (int i = 0; i < SEGMENT_SLOTS; ++i) {
+                int expected = -1;
+                if (seg->slots[i].owner.compare_exchange_strong(expected, tid)) return &seg->slots[i];
+            }
+        }
+        // finally: grow the slab by pushing a new segment on the front
+        Segment * seg = new Segment(tid);
+        Segment * oldHead = head;
+        do {
+            seg->next = oldHead;
+        } while (!head.compare_exchange_weak(oldHead, seg));
+        return &seg->slots[0];
+    }
+public:
+    ThreadSlotSlab() : slabId(nextSlabId++), head(nullptr) {}
+    ~ThreadSlotSlab() {
+        Segment * seg = head;
+        while (seg) {
+            Segment * next = seg->next;
+            delete seg;
+            seg = next;
+        }
+    }
+    // return the slot owned by tid, claiming one if necessary
+    Slot * get(int tid) {
+        CacheEntry & e = getCache()[slabId % CACHE_SIZE];
+        if (e.slabId == slabId && e.tid == tid && e.slot->owner.load(std::memory_order_relaxed) == tid) {
+            return e.slot;
+        }
+        Slot * slot = claim(tid);
+        e.slabId = slabId;
+        e.tid = tid;
+        e.slot = slot;
+        return slot;
+    }
+    // give a slot back (must only be called by the thread that owns it)
+    void release(Slot * slot) {
+        slot->owner.store(-1, std::memory_order_release);
+    }
+    // invoke f on every slot that is currently claimed
+    template <class F>
+    void forEachClaimed(F f) {
+        for (Segment * seg = head; seg; seg = seg->next) {
+            for (int i = 0; i < SEGMENT_SLOTS; ++i) {
+                if (seg->slots[i].owner.load(std::memory_order_acquire) != -1) f(&seg->slots[i]);
+            }
+        }
+    }
+};
+
 class CounterApproximate {
 private:
+    struct approx_slot_t {
+        atomic<int> owner;
+        atomic<int64_t> v {0};
+        volatile char padding[64-sizeof(atomic<int>)-sizeof(atomic<int64_t>)];
+    };
     static const int64_t c = 8; // error constant
     char padding0[64];
     atomic<int64_t> approx_value;
     char padding1[64];
-    padded_int64_t threadScratch[MAX_THREADS]; // local thread counts and padding
-    char padding2[64];
+    ThreadSlotSlab<approx_slot_t> threadScratch; // local thread counts, claimed on first use
     int numThreads;
     char padding3[64];
 public:
@@ -85,56 +204,79 @@ public:
     }
 
     int64_t inc(int tid) {
+        approx_slot_t * slot = threadScratch.get(tid);
         // Take current thread's value and add one.
-        int64_t current_value = ++threadScratch[tid].v;
+        int64_t current_value = ++slot->v;
         if (current_value >= c * numThreads){
             // atomically add c*numThreads
             std::atomic_fetch_add(&approx_value, c*numThreads);
-            threadScratch[tid].v = 0; // reset this thread's count to 0 
+            slot->v = 0; // reset this thread's count to 0 
         }
         return 0;
     }
     int64_t read() {
         return approx_value;
     }
+    // fold this thread's residue into the shared value and give up its slot
+    void release(int tid) {
+        approx_slot_t * slot = threadScratch.get(tid);
+        std::atomic_fetch_add(&approx_value, slot->v.load());
+        slot->v = 0;
+        threadScratch.release(slot);
+    }
 };
 
 
 class CounterShardedLocked {
 private:
+    struct locked_slot_t {
+        atomic<int> owner;
+        std::mutex m;
+        int64_t v = 0;
+        volatile char padding[64-sizeof(atomic<int>)-sizeof(std::mutex)-sizeof(int64_t)];
+    };
     char padding0[64];
-    std::mutex mutexes[MAX_THREADS];
-    char padding1[64];
-    padded_int64_t threadScratch[MAX_THREADS]; // local thread counts and padding
-    char padding2[64];
-    int numThreads;
+    ThreadSlotSlab<locked_slot_t> threadScratch; // local thread counts and locks, claimed on first use
+    int64_t base; // residue folded in by released slots (protected by the lock of the slot being released)
     char padding3[64];
 public:
-    CounterShardedLocked(int _numThreads) : numThreads(_numThreads) {
+    CounterShardedLocked(int _numThreads) : base(0) {
     }
     int64_t inc(int tid) {
         // Aquire our own thread and then increment
-        mutexes[tid].lock();
-        threadScratch[tid].v++;
-        mutexes[tid].unlock();
+        locked_slot_t * slot = threadScratch.get(tid);
+        slot->m.lock();
+        slot->v++;
+        slot->m.unlock();
         return 0;
     }
     int64_t read() {
-        // Lock every counter
-        for (int i = 0; i < numThreads; ++i){
-            mutexes[i].lock();
-        }
+        // Lock every claimed counter (unused slots are skipped)
+        vector<locked_slot_t *> locked;
+        threadScratch.forEachClaimed([&](locked_slot_t * slot) {
+            slot->m.lock();
+            locked.push_back(slot);
+        });
         // Sum the counters
-        int64_t total = 0;
-        for (int i = 0; i < numThreads; ++i){
-            total += threadScratch[i].v;
+        int64_t total = __atomic_load_n(&base, __ATOMIC_ACQUIRE);
+        for (auto slot : locked){
+            total += slot->v;
         }
         // Free the locks
-        for (int i = 0; i < numThreads; ++i){
-            mutexes[i].unlock();
+        for (auto slot : locked){
+            slot->m.unlock();
         }
         return total;
     }
+    // fold this thread's count into base and give up its slot
+    void release(int tid) {
+        locked_slot_t * slot = threadScratch.get(tid);
+        slot->m.lock();
+        __atomic_fetch_add(&base, slot->v, __ATOMIC_RELEASE);
+        slot->v = 0;
+        slot->m.unlock();
+        threadScratch.release(slot);
+    }
 };
 
 
@@ -145,8 +287,17 @@ private:
     char padding2[64];
     int numThreads;
     char padding3[64];
+    // snapshot published by readWithin(), so frequent readers can skip the O(threads) scan
+    atomic<int64_t> snapshotValue;
+    atomic<int64_t> snapshotTimeNs;
+    atomic<bool> refreshing;
+    char padding4[64];
+
+    static int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
 public:
-    CounterShardedWaitfree(int _numThreads) : numThreads(_numThreads) {
+    CounterShardedWaitfree(int _numThreads) : numThreads(_numThreads), snapshotValue(0), snapshotTimeNs(0), refreshing(false) {
         threadScratch = new padded_int64_t[numThreads];
     }
     ~CounterShardedWaitfree() {
@@ -164,6 +315,466 @@ public:
         }
         return total;
     }
+    // Return a value that was accurate at most maxStalenessNs ago (if any thread has refreshed it recently).
+    // If the snapshot is too old, one reader rescans the slots while the rest keep returning the old snapshot.
+    int64_t readWithin(int64_t maxStalenessNs) {
+        int64_t now = nowNs();
+        if (now - snapshotTimeNs.load(std::memory_order_acquire) <= maxStalenessNs) {
+            return snapshotValue.load(std::memory_order_relaxed);
+        }
+        if (refreshing.load(std::memory_order_relaxed) || refreshing.exchange(true, std::memory_order_acquire)) {
+            // someone else is refreshing
+            return snapshotValue.load(std::memory_order_relaxed);
+        }
+        int64_t total = read();
+        snapshotValue.store(total, std::memory_order_relaxed);
+        snapshotTimeNs.store(now, std::memory_order_release); // time the scan started, so staleness is never underestimated
+        refreshing.store(false, std::memory_order_release);
+        return total;
+    }
+};
+
+
+// Per-thread slots fold into one aggregate per NUMA node (socket), so a read
+// touches one cache line per socket instead of one per thread.
+// A thread only publishes after FOLD_THRESHOLD local increments, so read() may
+// lag the true value by at most numThreads*(FOLD_THRESHOLD-1), until each
+// thread calls release() to fold in the rest of its count.
+// The socket is looked up (via numa_tools.h) when folding, so a thread that
+// migrates simply starts folding into its new socket's aggregate.
+class CounterNumaHierarchical {
+private:
+    static const int64_t FOLD_THRESHOLD = 64;
+    char padding0[64];
+    padded_int64_t * threadScratch; // local thread counts (only written by the owner)
+    char padding1[64];
+    padded_int64_t * socketTotals;  // one cache line per socket
+    char padding2[64];
+    int numThreads;
+    int numSockets;
+    char padding3[64];
+
+    int mySocket() {
+        int node = __numa.get_node_periodic();
+        if (node < 0) node = __numa.get_node_slow();
+        return node % numSockets;
+    }
+public:
+    CounterNumaHierarchical(int _numThreads) : numThreads(_numThreads) {
+        numSockets = __numa.get_num_nodes();
+        threadScratch = new padded_int64_t[numThreads];
+        socketTotals = new padded_int64_t[numSockets];
+        for (int i = 0; i < numThreads; ++i) threadScratch[i].v = 0;
+        for (int i = 0; i < numSockets; ++i) socketTotals[i].v = 0;
+    }
+    ~CounterNumaHierarchical() {
+        delete [] threadScratch;
+        delete [] socketTotals;
+    }
+    int64_t inc(int tid) {
+        // only we write our slot, so a plain load/store (no lock prefix) is enough
+        int64_t local = threadScratch[tid].v.load(std::memory_order_relaxed) + 1;
+        if (local >= FOLD_THRESHOLD) {
+            socketTotals[mySocket()].v.fetch_add(local);
+            local = 0;
+        }
+        threadScratch[tid].v.store(local, std::memory_order_relaxed);
+        return 0;
+    }
+    int64_t read() {
+        int64_t total = 0;
+        for (int i = 0; i < numSockets; ++i){
+            total += socketTotals[i].v;
+        }
+        return total;
+    }
+    // fold the rest of this thread's count (less than FOLD_THRESHOLD) into its socket's aggregate
+    void release(int tid) {
+        int64_t local = threadScratch[tid].v.load(std::memory_order_relaxed);
+        if (local) socketTotals[mySocket()].v.fetch_add(local);
+        threadScratch[tid].v.store(0, std::memory_order_relaxed);
+    }
+};
+
+
+// Per-CPU counter built on restartable sequences (rseq).
+// Slots are indexed by the CPU we are running on rather than by tid, so the
+// counter uses one cache line per CPU no matter how many threads there are,
+// and read() only sums nproc slots.
+// inc() reads the current cpu id from the rseq area that glibc registers for
+// every thread, and then does a plain (non-locked) add on that CPU's slot.
+// The add is the commit instruction of the rseq critical section, so if we
+// are preempted or migrated before it executes, the kernel restarts us at the
+// abort handler, which simply retries.
+// If the kernel or glibc does not provide rseq, we fall back to sched_getcpu()
+// and an atomic add (slots are then only "mostly" uncontended).
+class CounterPerCpuRseq {
+private:
+    char padding0[64];
+    padded_int64_t * cpuScratch; // one slot per CPU
+    char padding1[64];
+    int numCpus;
+    bool useRseq;
+    char padding2[64];
+
+#ifdef COUNTER_HAVE_RSEQ
+    static struct rseq * getRseqArea() {
+        return (struct rseq *) ((char *) __builtin_thread_pointer() + __rseq_offset);
+    }
+
+    // add 1 to the slot for the current cpu without any atomic instruction
+    void rseqInc() {
+        static_assert(sizeof(padded_int64_t) == 64, "rseqInc assumes 64 byte slots");
+        struct rseq * rs = getRseqArea();
+        __asm__ __volatile__ (
+            ".pushsection __rseq_cs, \"aw\"\n\t"
+            ".balign 32\n\t"
+            "3:\n\t"
+            ".long 0x0, 0x0\n\t"                  // version, flags
+            ".quad 1f, (2f - 1f), 4f\n\t"         // start_ip, post_commit_offset, abort_ip
+            ".popsection\n\t"
+            "6:\n\t"
+            "leaq 3b(%%rip), %%rax\n\t"
+            "movq %%rax, %[rseq_cs]\n\t"          // arm the critical section
+            "1:\n\t"
+            "movl %[cpu_id], %%eax\n\t"
+            "shlq $6, %%rax\n\t"
+            "addq $1, (%[slots], %%rax)\n\t"      // commit
+            "2:\n\t"
+            ".pushsection __rseq_failure, \"ax\"\n\t"
+            ".byte 0x0f, 0xb9, 0x3d\n\t"          // ud1 <sig>(%rip),%edi so the signature decodes as an instruction
+            ".long %c[sig]\n\t"
+            "4:\n\t"
+            "jmp 6b\n\t"                          // aborted: the kernel cleared rseq_cs, so re-arm and retry
+            ".popsection\n\t"
+            : [rseq_cs] "=m" (rs->rseq_cs)
+            : [cpu_id] "m" (rs->cpu_id), [slots] "r" (cpuScratch), [sig] "i" (RSEQ_SIG)
+            : "rax", "memory", "cc"
+        );
+    }
+#endif
+public:
+    CounterPerCpuRseq(int _numThreads) {
+        numCpus = sysconf(_SC_NPROCESSORS_CONF);
+        cpuScratch = new padded_int64_t[numCpus];
+        for (int i = 0; i < numCpus; ++i) cpuScratch[i].v = 0;
+#ifdef COUNTER_HAVE_RSEQ
+        useRseq = (__rseq_size > 0);
+#else
+        useRseq = false;
+#endif
+    }
+    ~CounterPerCpuRseq() {
+        delete [] cpuScratch;
+    }
+    int64_t inc(int tid) {
+#ifdef COUNTER_HAVE_RSEQ
+        // cpu_id is negative if registration failed for this thread
+        if (useRseq && (int32_t) getRseqArea()->cpu_id >= 0) {
+            rseqInc();
+            return 0;
+        }
+#endif
+        cpuScratch[sched_getcpu() % numCpus].v++;
+        return 0;
+    }
+    int64_t read() {
+        int64_t total = 0;
+        for (int i = 0; i < numCpus; ++i){
+            total += cpuScratch[i].v;
+        }
+        return total;
+    }
+    bool isUsingRseq() {
+        return useRseq;
+    }
+};
+
+
+// Software combining tree (Herlihy & Shavit, ch. 12).
+// Threads pair up at the leaves and the first thread to arrive at a node
+// carries its partner's increments up the tree, so the root only sees one
+// fetch&add per combined batch. Each inc still returns an exact, unique
+// pre-increment value, which is handed back down the tree in distribute().
+class CounterCombiningTree {
+private:
+    enum CombiningStatus { IDLE, FIRST, SECOND, RESULT, ROOT };
+
+    struct CombiningNode {
+        char padding0[64];
+        std::mutex m;
+        std::condition_variable cv;
+        bool locked;
+        CombiningStatus status;
+        int64_t firstValue;
+        int64_t secondValue;
+        int64_t result;
+        atomic<int64_t> rootValue; // only used by the root
+        CombiningNode * parent;
+        char padding1[64];
+
+        CombiningNode() : locked(false), status(IDLE), firstValue(0), secondValue(0), result(0), rootValue(0), parent(nullptr) {}
+
+        // returns true if we are the first thread to reach this node (so we continue upward)
+        bool precombine() {
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock, [this] { return !locked; });
+            switch (status) {
+            case IDLE:
+                status = FIRST;
+                return true;
+            case FIRST:
+                // second thread to arrive: lock the node so the first thread waits for our value
+                locked = true;
+                status = SECOND;
+                return false;
+            case ROOT:
+                return false;
+            default:
+                printf("ERROR: unexpected status %d in CombiningNode::precombine\n", status);
+                exit(1);
+            }
+        }
+
+        // returns the total of the increments gathered at this node so far
+        int64_t combine(int64_t combined) {
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock, [this] { return !locked; });
+            locked = true;
+            firstValue = combined;
+            switch (status) {
+            case FIRST:
+                return firstValue;
+            case SECOND:
+                return firstValue + secondValue;
+            default:
+                printf("ERROR: unexpected status %d in CombiningNode::combine\n", status);
+                exit(1);
+            }
+        }
+
+        // either apply the batch at the root, or hand our value to the first thread and wait for the result
+        int64_t op(int64_t combined) {
+            if (status == ROOT) {
+                return rootValue.fetch_add(combined);
+            }
+            std::unique_lock<std::mutex> lock(m);
+            switch (status) {
+            case SECOND: {
+                secondValue = combined;
+                locked = false;
+                cv.notify_all();
+                cv.wait(lock, [this] { return status == RESULT; });
+                locked = false;
+                status = IDLE;
+                cv.notify_all();
+                return result;
+            }
+            default:
+                printf("ERROR: unexpected status %d in CombiningNode::op\n", status);
+                exit(1);
+            }
+        }
+
+        // pass the prior value back down the tree
+        void distribute(int64_t prior) {
+            std::unique_lock<std::mutex> lock(m);
+            switch (status) {
+            case FIRST:
+                status = IDLE;
+                locked = false;
+                break;
+            case SECOND:
+                result = prior + firstValue;
+                status = RESULT;
+                break;
+            default:
+                printf("ERROR: unexpected status %d in CombiningNode::distribute\n", status);
+                exit(1);
+            }
+            cv.notify_all();
+        }
+    };
+
+    char padding0[64];
+    CombiningNode * nodes;  // complete binary tree stored as an array, nodes[0] is the root
+    CombiningNode ** leaves; // two threads share each leaf
+    int width;
+    int numThreads;
+    char padding1[64];
+public:
+    CounterCombiningTree(int _numThreads) : numThreads(_numThreads) {
+        // tree width must be a power of two that covers every thread
+        width = 2;
+        while (width < numThreads) width *= 2;
+
+        nodes = new CombiningNode[width-1];
+        nodes[0].status = ROOT;
+        for (int i = 1; i < width-1; ++i) {
+            nodes[i].parent = &nodes[(i-1)/2];
+        }
+        leaves = new CombiningNode*[width/2];
+        for (int i = 0; i < width/2; ++i) {
+            leaves[i] = &nodes[width-2-i];
+        }
+    }
+    ~CounterCombiningTree() {
+        delete [] leaves;
+        delete [] nodes;
+    }
+    int64_t inc(int tid) {
+        CombiningNode * path[64]; // nodes we combined through, deepest first
+        int pathSize = 0;
+        CombiningNode * myLeaf = leaves[tid/2];
+
+        // precombining phase: climb until we are the second thread at a node (or hit the root)
+        CombiningNode * node = myLeaf;
+        while (node->precombine()) node = node->parent;
+        CombiningNode * stop = node;
+
+        // combining phase: collect increments from partners along the way up
+        node = myLeaf;
+        int64_t combined = 1;
+        while (node != stop) {
+            combined = node->combine(combined);
+            path[pathSize++] = node;
+            node = node->parent;
+        }
+
+        // operation phase: apply the batch at the root, or wait for the first thread to do it
+        int64_t prior = stop->op(combined);
+
+        // distribution phase: hand results back down to partners
+        while (pathSize > 0) {
+            path[--pathSize]->distribute(prior);
+        }
+        return prior;
+    }
+    int64_t read() {
+        return nodes[0].rootValue;
+    }
+};
+
+
+// Scalable NonZero Indicator (Ellen, Lev, Luchangco & Moir, PODC 2007).
+// Only answers "is the number of arrivals minus departures nonzero?", which
+// lets most arrive/depart operations stay on a leaf of the tree: a node only
+// arrives at (departs from) its parent when its own surplus goes 0 -> 1 (1 -> 0).
+// query() reads a single word (the root surplus).
+// Tree nodes hold (count, version) in one word. The count is stored doubled so
+// that the intermediate "1/2" state of the paper (count=1) fits in an integer.
+class NonZeroIndicatorSNZI {
+private:
+    struct snzi_node_t {
+        char padding0[64];
+        atomic<uint64_t> word; // high 32 bits: 2*count, low 32 bits: version
+        snzi_node_t * parent;  // nullptr if our parent is the root
+        char padding1[64];
+    };
+    static uint64_t makeWord(uint32_t c2, uint32_t v) { return ((uint64_t) c2 << 32) | v; }
+    static uint32_t countOf(uint64_t w) { return w >> 32; }
+    static uint32_t versionOf(uint64_t w) { return (uint32_t) w; }
+
+    char padding0[64];
+    atomic<int64_t> rootSurplus; // the indicator
+    char padding1[64];
+    snzi_node_t * nodes;  // nodes[0] is unused (it plays the role of the root)
+    snzi_node_t ** leaves;
+    int width;
+    char padding2[64];
+
+    void arriveAt(snzi_node_t * node) {
+        if (node == nullptr) {
+            rootSurplus.fetch_add(1);
+            return;
+        }
+        bool succ = false;
+        int undoArrivals = 0;
+        while (!succ) {
+            uint64_t x = node->word;
+            if (countOf(x) >= 2) {
+                if (node->word.compare_exchange_strong(x, makeWord(countOf(x)+2, versionOf(x)))) succ = true;
+            } else if (countOf(x) == 0) {
+                uint64_t y = makeWord(1, versionOf(x)+1);
+                if (node->word.compare_exchange_strong(x, y)) {
+                    succ = true;
+                    x = y;
+                }
+            }
+            if (countOf(x) == 1) {
+                // surplus is 1/2: someone is arriving at the parent on this node's behalf, so help
+                arriveAt(node->parent);
+                if (!node->word.compare_exchange_strong(x, makeWord(2, versionOf(x)))) ++undoArrivals;
+            }
+        }
+        // undo parent arrivals that turned out not to be needed
+        while (undoArrivals > 0) {
+            departFrom(node->parent);
+            --undoArrivals;
+        }
+    }
+
+    void departFrom(snzi_node_t * node) {
+        if (node == nullptr) {
+            rootSurplus.fetch_sub(1);
+            return;
+        }
+        while (true) {
+            uint64_t x = node->word;
+            if (node->word.compare_exchange_strong(x, makeWord(countOf(x)-2, versionOf(x)))) {
+                if (countOf(x) == 2) departFrom(node->parent);
+                return;
+            }
+        }
+    }
+public:
+    NonZeroIndicatorSNZI(int _numThreads) : rootSurplus(0) {
+        // binary tree with two threads per leaf (same shape as the combining tree)
+        width = 2;
+        while (width < _numThreads) width *= 2;
+        nodes = new snzi_node_t[width-1];
+        for (int i = 1; i < width-1; ++i) {
+            nodes[i].word = 0;
+            nodes[i].parent = ((i-1)/2 == 0) ? nullptr : &nodes[(i-1)/2];
+        }
+        leaves = new snzi_node_t*[width/2];
+        for (int i = 0; i < width/2; ++i) {
+            int ix = width-2-i;
+            leaves[i] = (ix == 0) ? nullptr : &nodes[ix];
+        }
+    }
+    ~NonZeroIndicatorSNZI() {
+        delete [] leaves;
+        delete [] nodes;
+    }
+    void arrive(int tid) {
+        arriveAt(leaves[tid/2]);
+    }
+    void depart(int tid) {
+        departFrom(leaves[tid/2]);
+    }
+    bool query() {
+        return rootSurplus.load() > 0;
+    }
+};
+
+// Baseline nonzero indicator: every arrive/depart hits one shared word.
+class NonZeroIndicatorFetchAndAdd {
+private:
+    char padding0[64];
+    atomic<int64_t> v;
+    char padding1[64];
+public:
+    NonZeroIndicatorFetchAndAdd(int _numThreads) : v(0) {}
+    void arrive(int tid) {
+        v.fetch_add(1);
+    }
+    void depart(int tid) {
+        v.fetch_sub(1);
+    }
+    bool query() {
+        return v.load() > 0;
+    }
 };
 
 
@@ -3,6 +3,12 @@
 
 #include <atomic>
 #include <chrono>
+#include <cstring>
+#include <x86intrin.h>
+#include <algorithm>
+#include <climits>
+#include <ctime>
+#include "../a7/common/spin_park.h"
 
 class ElapsedTimer {
 private:
@@ -26,18 +32,86 @@ public:
     }
 };
 
+// threads that arrive early spin briefly and then park, so they don't steal
+// cores from threads that have not arrived yet (e.g., when oversubscribed)
 class Barrier {
 private:
     char padding0[64];
     const int releaseValue;
     char padding1[64];
-    std::atomic<int> v;
+    ParkingWord v;
     char padding2[64];
 public:
     Barrier(int _releaseValue) : releaseValue(_releaseValue), v(0) {}
     void wait() {
-        v++;
-        while (v < releaseValue) {}
+        v.fetch_add(1);
+        v.waitUntil([this](int arrived) { return arrived >= releaseValue; });
+    }
+};
+
+// read the timestamp counter around a measured operation
+// (the fences keep the operation from being reordered outside the timed region)
+static inline uint64_t rdtscStart() {
+    _mm_lfence();
+    return __rdtsc();
+}
+static inline uint64_t rdtscEnd() {
+    unsigned int aux;
+    uint64_t t = __rdtscp(&aux);
+    _mm_lfence();
+    return t;
+}
+
+// Log-linear histogram (in the style of HdrHistogram): values are grouped by
+// their highest set bit, and each power of two is split into 16 linear
+// sub-buckets, so every recorded value is kept within ~6% of its true value.
+// Each thread records into its own histogram, and they are merged at the end.
+class LatencyHistogram {
+private:
+    static const int SUB_BUCKET_BITS = 4;
+    static const int SUB_BUCKETS = 1<<SUB_BUCKET_BITS;
+    static const int NUM_BUCKETS = 64*SUB_BUCKETS;
+    char padding0[64];
+    int64_t counts[NUM_BUCKETS];
+    int64_t total;
+    char padding1[64];
+
+    static int bucketOf(uint64_t v) {
+        if (v < SUB_BUCKETS) return v;
+        int msb = 63 - __builtin_clzll(v);
+        int shift = msb - SUB_BUCKET_BITS;
+        return (shift+1)*SUB_BUCKETS + ((v >> shift) & (SUB_BUCKETS-1));
+    }
+    static uint64_t lowerBoundOf(int bucket) {
+        if (bucket < SUB_BUCKETS) return bucket;
+        int shift = bucket/SUB_BUCKETS - 1;
+        return (uint64_t) (SUB_BUCKETS + bucket%SUB_BUCKETS) << shift;
+    }
+public:
+    LatencyHistogram() : total(0) {
+        memset(counts, 0, sizeof(counts));
+    }
+    void record(uint64_t v) {
+        ++counts[bucketOf(v)];
+        ++total;
+    }
+    void merge(LatencyHistogram * other) {
+        for (int i=0;i<NUM_BUCKETS;++i) counts[i] += other->counts[i];
+        total += other->total;
+    }
+    int64_t getTotal() {
+        return total;
+    }
+    // smallest recorded value v such that at least fraction p of samples are <= v (within bucket precision)
+    uint64_t percentile(double p) {
+        int64_t target = (int64_t) (p * total);
+        if (target < 1) target = 1;
+        int64_t seen = 0;
+        for (int i=0;i<NUM_BUCKETS;++i) {
+            seen += counts[i];
+            if (seen >= target) return lowerBoundOf(i);
+        }
+        return 0;
     }
 };
 
@@ -3,6 +3,7 @@
 #include <vector>
 #include <thread>
 #include <atomic>
+#include <unistd.h>
 using namespace std;
 
 #include "util.h"
@@ -25,6 +26,7 @@ struct globals_t {
     // variable used to track the number of increment operations performed by all threads
     // note: for efficiency, each thread counts its own operations, then does fetch&add on this variable ONCE
     atomic<int64_t> incrementsPerformed;
+    atomic<int64_t> readsPerformed;
     
     char padding3[64];
     
@@ -34,45 +36,152 @@ struct globals_t {
     
     int64_t numThreads;
     int64_t millisToRun;
+    int64_t readPercent; // percentage of operations that are reads instead of increments
+    int64_t numReaderThreads; // extra threads that only read (tids numThreads .. numThreads+numReaderThreads-1)
     
     char padding5[64];
+    
+    // per-thread latency histograms (each thread allocates its own, main merges them at the end)
+    LatencyHistogram ** incLatency;
+    LatencyHistogram ** readLatency;
+    
+    char padding6[64];
 
-    globals_t(int64_t numThreads, int64_t millisToRun) {
-        barrier = new Barrier(1+numThreads);
+    globals_t(int64_t numThreads, int64_t millisToRun, int64_t readPercent = 0, int64_t numReaderThreads = 0) {
+        barrier = new Barrier(1+numThreads+numReaderThreads);
         timer = new ElapsedTimer();
         incrementsPerformed = 0;
+        readsPerformed = 0;
         counter = new CounterType(numThreads);
         this->numThreads = numThreads;
         this->millisToRun = millisToRun;
+        this->readPercent = readPercent;
+        this->numReaderThreads = numReaderThreads;
+        incLatency = new LatencyHistogram * [numThreads+numReaderThreads]();
+        readLatency = new LatencyHistogram * [numThreads+numReaderThreads]();
     }
     ~globals_t() {
         // manually free memory for objects allocated with "new"
         delete barrier;
         delete timer;
         delete counter;
+        for (int i=0;i<numThreads+numReaderThreads;++i) {
+            delete incLatency[i];
+            delete readLatency[i];
+        }
+        delete [] incLatency;
+        delete [] readLatency;
+    }
+};
+
+// lets a nonzero indicator run in this benchmark:
+// each "increment" is an arrive/depart pair (like a reader entering and leaving),
+// and each "read" is a query (like a writer checking for readers)
+template <class IndicatorType>
+class IndicatorAsCounter {
+private:
+    IndicatorType indicator;
+public:
+    IndicatorAsCounter(int _numThreads) : indicator(_numThreads) {}
+    int64_t inc(int tid) {
+        indicator.arrive(tid);
+        indicator.depart(tid);
+        return 0;
+    }
+    int64_t read() {
+        return indicator.query();
     }
 };
 
+// only one in every (LATENCY_SAMPLE_MASK+1) operations is timed, to keep rdtsc overhead low
+#define LATENCY_SAMPLE_MASK 127
+
 template <class CounterType>
 void threadFunc(int tid, globals_t<CounterType> * g) {
+    LatencyHistogram * incLatency = g->incLatency[tid] = new LatencyHistogram();
+    LatencyHistogram * readLatency = g->readLatency[tid] = new LatencyHistogram();
+
     // wait for all threads to start
     g->barrier->wait();
     printf("thread %d start (counter=%ld)\n", tid, g->counter->read());
 
-    // do increments
+    // do increments (and reads, if readPercent > 0)
     int64_t last = 0;
     int64_t i;
+    int64_t reads = 0;
+    uint32_t seed = tid+1; // xorshift state used to choose between inc and read
     for (i=0; ; ++i) {
-        last = g->counter->inc(tid);
+        bool isRead = false;
+        if (g->readPercent > 0) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            isRead = (seed % 100 < g->readPercent);
+        }
+        if ((i & LATENCY_SAMPLE_MASK) == 0) {
+            uint64_t t0 = rdtscStart();
+            last = isRead ? g->counter->read() : g->counter->inc(tid);
+            uint64_t t1 = rdtscEnd();
+            (isRead ? readLatency : incLatency)->record(t1 - t0);
+        } else {
+            last = isRead ? g->counter->read() : g->counter->inc(tid);
+        }
+        reads += isRead;
 
         // check timer to see if we should terminate
         // (to reduce overhead of timing calls, do this only once every X increments)
         if ((i & 1023) == 0) if (g->timer->getElapsedMillis() >= g->millisToRun) break;
     }
-    g->incrementsPerformed.fetch_add(i+1);
+    // counters that hand out per-thread slots on demand want them back when a thread is done
+    if constexpr (requires { g->counter->release(tid); }) {
+        g->counter->release(tid);
+    }
+    g->incrementsPerformed.fetch_add(i+1-reads);
+    g->readsPerformed.fetch_add(reads);
     printf("thread %d end (last counter value seen %ld)\n", tid, last);
 }
 
+// dedicated reader thread: only performs reads
+template <class CounterType>
+void readerThreadFunc(int tid, globals_t<CounterType> * g) {
+    LatencyHistogram * readLatency = g->readLatency[tid] = new LatencyHistogram();
+
+    g->barrier->wait();
+
+    int64_t last = 0;
+    int64_t i;
+    for (i=0; ; ++i) {
+        if ((i & LATENCY_SAMPLE_MASK) == 0) {
+            uint64_t t0 = rdtscStart();
+            last = g->counter->read();
+            uint64_t t1 = rdtscEnd();
+            readLatency->record(t1 - t0);
+        } else {
+            last = g->counter->read();
+        }
+        if ((i & 1023) == 0) if (g->timer->getElapsedMillis() >= g->millisToRun) break;
+    }
+    g->readsPerformed.fetch_add(i+1);
+    printf("reader thread %d end (last counter value seen %ld)\n", tid, last);
+}
+
+// merge per-thread histograms and print percentiles in cycles and (approximate) nanoseconds
+void printLatency(const char * opName, LatencyHistogram ** perThread, int n, double cyclesPerNs) {
+    LatencyHistogram merged;
+    for (int i=0;i<n;++i) {
+        if (perThread[i]) merged.merge(perThread[i]);
+    }
+    if (merged.getTotal() == 0) return;
+    const double ps[] = {0.5, 0.99, 0.999};
+    const char * names[] = {"p50", "p99", "p99.9"};
+    printf("%s latency (%ld samples):", opName, merged.getTotal());
+    for (int i=0;i<3;++i) {
+        uint64_t cycles = merged.percentile(ps[i]);
+        printf(" %s=%lu cycles (%.0f ns)", names[i], cycles, cycles / cyclesPerNs);
+    }
+    printf("\n");
+}
+
 template <class CounterType>
 void runExperiment(globals_t<CounterType> * g) {
     
@@ -81,8 +190,12 @@ void runExperiment(globals_t<CounterType> * g) {
     for (int tid=0; tid < g->numThreads; ++tid) {
         threads.push_back(new thread(threadFunc<CounterType>, tid, g));
     }
+    for (int tid=g->numThreads; tid < g->numThreads + g->numReaderThreads; ++tid) {
+        threads.push_back(new thread(readerThreadFunc<CounterType>, tid, g));
+    }
     
     g->timer->start();
+    uint64_t tscStart = __rdtsc();
     g->barrier->wait();
     
     // wait for all threads to terminate (and explicitly free memory allocated with "new" for the thread)
@@ -91,36 +204,74 @@ void runExperiment(globals_t<CounterType> * g) {
         delete t;
     }
     
+    // calibrate the timestamp counter against the wall clock so we can report latencies in ns
+    uint64_t tscEnd = __rdtsc();
+    int64_t elapsedMillis = g->timer->getElapsedMillis();
+    double cyclesPerNs = (tscEnd - tscStart) / (elapsedMillis * 1e6);
+    
     printf("\n");
     printf("final counter value after %ld increments is %ld\n", g->incrementsPerformed.load(), g->counter->read());
     printf("increments/s: %ld\n", g->incrementsPerformed.load() * 1000 / g->millisToRun);
+    if (g->readPercent > 0 || g->numReaderThreads > 0) {
+        printf("reads/s: %ld\n", g->readsPerformed.load() * 1000 / g->millisToRun);
+    }
+    int n = g->numThreads + g->numReaderThreads;
+    printLatency("inc", g->incLatency, n, cyclesPerNs);
+    printLatency("read", g->readLatency, n, cyclesPerNs);
     printf("\n");
 }
 
 int main(int argc, char ** argv) {
     // parse command line args
-    if (argc != 4) {
-        printf("USAGE: %s NUM_THREADS MILLIS_TO_RUN COUNTER_TYPE_NAME\n", argv[0]);
-        printf("       where COUNTER_TYPE_NAME in {naive, lock, faa, approx, shard_lock, shard_wf}\n");
+    if (argc < 4 || argc > 6) {
+        printf("USAGE: %s NUM_THREADS MILLIS_TO_RUN COUNTER_TYPE_NAME [READ_PERCENT [NUM_READER_THREADS]]\n", argv[0]);
+        printf("       where COUNTER_TYPE_NAME in {naive, lock, faa, approx, shard_lock, shard_wf, combtree, numa_hier, percpu, snzi, faa_ind}\n");
+        printf("       NUM_THREADS may be given as Kx to oversubscribe: run K threads per online core (e.g., 4x)\n");
+        printf("       READ_PERCENT (default 0) is the percentage of operations that are reads\n");
+        printf("       NUM_READER_THREADS (default 0) extra threads that only read\n");
         return 1;
     }
-    const int numThreads = atoll(argv[1]);
+    // oversubscribed mode: "Kx" means K threads for every online core
+    const int numCores = sysconf(_SC_NPROCESSORS_ONLN);
+    const bool oversubscribe = (argv[1][0] && argv[1][strlen(argv[1])-1] == 'x');
+    const int numThreads = oversubscribe ? atoll(argv[1]) * numCores : atoll(argv[1]);
     const int millisToRun = atoll(argv[2]);
+    const int readPercent = (argc >= 5) ? atoll(argv[4]) : 0;
+    const int numReaderThreads = (argc >= 6) ? atoll(argv[5]) : 0;
+    if (numThreads < 1 || numThreads + numReaderThreads > MAX_THREADS) {
+        printf("ERROR: NUM_THREADS=%d plus NUM_READER_THREADS=%d must be in [1, MAX_THREADS=%d]\n", numThreads, numReaderThreads, MAX_THREADS);
+        return 1;
+    }
+    if (numThreads + numReaderThreads > numCores) {
+        printf("oversubscribed: %d threads on %d online cores\n", numThreads + numReaderThreads, numCores);
+    }
 
     // create the counter that threads will access and invoke runExperiment
     // (providing counter type information via templates -- orders of magnitude faster than polymorphism)
     if (!strcmp(argv[3], "naive")) {
-        runExperiment(new globals_t<CounterNaive>(numThreads, millisToRun));
+        runExperiment(new globals_t<CounterNaive>(numThreads, millisToRun, readPercent, numReaderThreads));
     } else if (!strcmp(argv[3], "lock")) {
-        runExperiment(new globals_t<CounterLocked>(numThreads, millisToRun));
+        runExperiment(new globals_t<CounterLocked>(numThreads, millisToRun, readPercent, numReaderThreads));
     } else if (!strcmp(argv[3], "faa")) {
-        runExperiment(new globals_t<CounterFetchAndAdd>(numThreads, millisToRun));
+        runExperiment(new globals_t<CounterFetchAndAdd>(numThreads, millisToRun, readPercent, numReaderThreads));
     } else if (!strcmp(argv[3], "approx")) {
-        runExperiment(new globals_t<CounterApproximate>(numThreads, millisToRun));
+        runExperiment(new globals_t<CounterApproximate>(numThreads, millisToRun, readPercent, numReaderThreads));
     } else if (!strcmp(argv[3], "shard_lock")) {
-        runExperiment(new globals_t<CounterShardedLocked>(numThreads, millisToRun));
+        runExperiment(new globals_t<CounterShardedLocked>(numThreads, millisToRun, readPercent, numReaderThreads));
     } else if (!strcmp(argv[3], "shard_wf")) {
-        runExperiment(new globals_t<CounterShardedWaitfree>(numThreads, millisToRun));
+        runExperiment(new globals_t<CounterShardedWaitfree>(numThreads, millisToRun, readPercent, numReaderThreads));
+    } else if (!strcmp(argv[3], "combtree")) {
+        runExperiment(new globals_t<CounterCombiningTree>(numThreads, millisToRun, readPercent, numReaderThreads));
+    } else if (!strcmp(argv[3], "numa_hier")) {
+        runExperiment(new globals_t<CounterNumaHierarchical>(numThreads, millisToRun, readPercent, numReaderThreads));
+    } else if (!strcmp(argv[3], "percpu")) {
+        auto g = new globals_t<CounterPerCpuRseq>(numThreads, millisToRun, readPercent, numReaderThreads);
+        printf("percpu counter is using %s\n", g->counter->isUsingRseq() ? "rseq" : "the sched_getcpu fallback");
+        runExperiment(g);
+    } else if (!strcmp(argv[3], "snzi")) {
+        runExperiment(new globals_t<IndicatorAsCounter<NonZeroIndicatorSNZI>>(numThreads, millisToRun, readPercent, numReaderThreads));
+    } else if (!strcmp(argv[3], "faa_ind")) {
+        runExperiment(new globals_t<IndicatorAsCounter<NonZeroIndicatorFetchAndAdd>>(numThreads, millisToRun, readPercent, numReaderThreads));
     } else {
         printf("ERROR: unexpected algorithm name %s\n", argv[3]);
         return 1;
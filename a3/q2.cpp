@@ -3,85 +3,163 @@
 #include <thread>
 #include <vector>
 #include <chrono>
+#include <cstring>
+#include <cstdlib>
 using namespace std;
 
 #define MAX_THREADS 256
+#define MAX_STRIDE 256 // bytes
 
-struct padded_subcounter {
-    atomic<int64_t> v;
-    char padding[64 - sizeof(atomic<int64_t>)];
+// how each thread increments its subcounter
+enum store_mode_t {
+    MODE_FAA,       // atomic fetch&add (lock-prefixed read-modify-write)
+    MODE_STORE,     // atomic load followed by a plain (relaxed) store
+    MODE_MIXED      // even threads use fetch&add, odd threads use plain stores
 };
+const char * modeNames[] = { "faa", "store", "mixed" };
 
+// subcounters are placed stride bytes apart (stride in [8, MAX_STRIDE]),
+// so a stride below the cache line size puts several threads' subcounters on one line,
+// and a stride of one line still lets the adjacent-line prefetcher pull in neighbours' lines
 struct globals {
     char padding0[64];
     int numThreads;
+    int stride;
+    store_mode_t mode;
     atomic<bool> start;
     atomic<bool> done;
-    char padding1[64]; // pad counter 0 from done
-    padded_subcounter subcounters[MAX_THREADS];
+    char padding1[MAX_STRIDE]; // pad counter 0 from done
+    char * subcounters;        // MAX_THREADS * stride bytes, aligned to MAX_STRIDE
     char padding2[64];
-    
-    globals(int _numThreads) {
+
+    globals(int _numThreads, int _stride, store_mode_t _mode) {
         numThreads = _numThreads;
+        stride = _stride;
+        mode = _mode;
         start = false;
         done = false;
+        subcounters = (char *) aligned_alloc(MAX_STRIDE, MAX_THREADS * MAX_STRIDE);
+        memset(subcounters, 0, MAX_THREADS * MAX_STRIDE);
+    }
+    ~globals() {
+        free(subcounters);
+    }
+    atomic<int64_t> & subcounter(int tid) {
+        return *((atomic<int64_t> *) (subcounters + tid * stride));
     }
 };
 
 globals * g;
 
-void threadFunc(int tid) {
+void threadFunc(int tid, bool printCount) {
     // wait for all threads to be started before letting any thread do "real" work
     int64_t myCount = 0;
+    atomic<int64_t> & mine = g->subcounter(tid);
+    bool useFaa = (g->mode == MODE_FAA) || (g->mode == MODE_MIXED && (tid % 2) == 0);
     while (!g->start) { /* busy wait */ }
 
     // increment my subcounter until the experiment is done
-    while (true) {
-        g->subcounters[tid].v += 1;
-        myCount++;
-        if (g->done) break;
+    if (useFaa) {
+        while (true) {
+            mine.fetch_add(1);
+            myCount++;
+            if (g->done) break;
+        }
+    } else {
+        while (true) {
+            mine.store(mine.load(memory_order_relaxed) + 1, memory_order_relaxed);
+            myCount++;
+            if (g->done) break;
+        }
     }
-    printf("Thread %d counted %ld\n", tid, myCount);
+    if (printCount) printf("Thread %d counted %ld\n", tid, myCount);
 }
 
-int main(int argc, char ** argv) {
-    // read command line args
-    if (argc != 3) {
-        cout<<"USAGE: "<<argv[0]<<" SECONDS_TO_RUN NUMBER_OF_THREADS"<<endl;
-        return 1;
-    }
-    int secondsToRun = atoi(argv[1]);
-    int numThreads = atoi(argv[2]);
-    
+// run one configuration, and return its throughput (increments per second)
+int64_t runTrial(double secondsToRun, int numThreads, int stride, store_mode_t mode, bool printCounts) {
     // initialize globals
-    g = new globals(numThreads);
-    
+    g = new globals(numThreads, stride, mode);
+
     // create and start threads
     vector<thread *> threads;
     for (int i=0;i<g->numThreads;++i) {
-        threads.push_back(new thread(threadFunc, i));
+        threads.push_back(new thread(threadFunc, i, printCounts));
     }
-    
 
     // have threads perform increments for a fixed time then stop
     g->start = true;
-    this_thread::sleep_for(chrono::seconds(secondsToRun));
+    this_thread::sleep_for(chrono::duration<double>(secondsToRun));
     g->done = true;
 
-    
     // join threads
     for (int i=0;i<g->numThreads;++i) {
         threads[i]->join();
         delete threads[i]; // free memory
     }
-    
-    // print: increments performed per second
+
+    // sum the subcounters
     int64_t sum = 0;
     for (int i=0;i<g->numThreads;++i) {
-        sum += g->subcounters[i].v;
+        sum += g->subcounter(i);
     }
-    cout<<"throughput (increments per second)="<<(sum / secondsToRun)<<endl;
-    
+
     delete g; // free memory allocated for globals (and call destructor)
+    return (int64_t) (sum / secondsToRun);
+}
+
+int main(int argc, char ** argv) {
+    // read command line args
+    if (argc < 3 || argc > 5) {
+        cout<<"USAGE: "<<argv[0]<<" SECONDS_TO_RUN NUMBER_OF_THREADS [STRIDE [MODE]]"<<endl;
+        cout<<"    SECONDS_TO_RUN     per configuration (may be fractional, e.g., 0.5)"<<endl;
+        cout<<"    STRIDE             bytes between consecutive threads' subcounters, or 'sweep' for 8, 16, ..., "<<MAX_STRIDE<<" [default 64]"<<endl;
+        cout<<"    MODE               in { faa, store, mixed, all } [default faa]"<<endl;
+        cout<<"                       faa: atomic fetch&add; store: atomic load + plain store; mixed: even threads faa, odd threads store"<<endl;
+        cout<<"Example (pick PADDING_BYTES for this machine): "<<argv[0]<<" 1 8 sweep all"<<endl;
+        return 1;
+    }
+    double secondsToRun = atof(argv[1]);
+    int numThreads = atoi(argv[2]);
+    const char * strideArg = (argc > 3) ? argv[3] : "64";
+    const char * modeArg = (argc > 4) ? argv[4] : "faa";
+
+    if (numThreads < 1 || numThreads > MAX_THREADS) {
+        cout<<"ERROR: NUMBER_OF_THREADS must be in [1, "<<MAX_THREADS<<"]"<<endl;
+        return 1;
+    }
+
+    vector<int> strides;
+    if (!strcmp(strideArg, "sweep")) {
+        for (int s=8;s<=MAX_STRIDE;s*=2) strides.push_back(s);
+    } else {
+        int s = atoi(strideArg);
+        if (s < 8 || s > MAX_STRIDE || (s % 8) != 0) {
+            cout<<"ERROR: STRIDE must be a multiple of 8 in [8, "<<MAX_STRIDE<<"]"<<endl;
+            return 1;
+        }
+        strides.push_back(s);
+    }
+
+    vector<store_mode_t> modes;
+    for (int m=MODE_FAA;m<=MODE_MIXED;++m) {
+        if (!strcmp(modeArg, "all") || !strcmp(modeArg, modeNames[m])) modes.push_back((store_mode_t) m);
+    }
+    if (modes.empty()) {
+        cout<<"ERROR: bad MODE "<<modeArg<<endl;
+        return 1;
+    }
+
+    // with a single configuration, behave as before (print per-thread counts)
+    bool single = (strides.size() == 1 && modes.size() == 1);
+    for (auto mode : modes) {
+        for (int stride : strides) {
+            auto throughput = runTrial(secondsToRun, numThreads, stride, mode, single);
+            if (single) {
+                cout<<"throughput (increments per second)="<<throughput<<endl;
+            } else {
+                cout<<"mode="<<modeNames[mode]<<" stride="<<stride<<" threads="<<numThreads<<" throughput="<<throughput<<endl;
+            }
+        }
+    }
     return 0;
 }
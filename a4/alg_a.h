@@ -4,11 +4,12 @@
 #include <mutex>
 using namespace std;
 
+template <class CapacityPolicy = ModuloCapacity, class HashPolicy = Murmur3Hash>
 class AlgorithmA {
 protected:
     struct lockedKey {
         mutex m;
-        int key = EMPTY; // Protected by lock, does not need atomic
+        int key = EMPTY; // written only while holding m, but contains() reads it without the lock
         char padding[PADDING_BYTES - sizeof(int) - sizeof(mutex)];
     };
 
@@ -22,12 +23,14 @@ public:
     char padding0[PADDING_BYTES];
     const int numThreads;
     int capacity;
+    CapacityPolicy slots;
     char padding2[PADDING_BYTES];
 
     AlgorithmA(const int _numThreads, const int _capacity);
     ~AlgorithmA();
     bool insertIfAbsent(const int tid, const int & key);
     bool erase(const int tid, const int & key);
+    bool contains(const int tid, const int & key);
     long getSumOfKeys();
     void printDebuggingDetails(); 
 };
@@ -38,22 +41,25 @@ public:
  * @param _numThreads maximum number of threads that will ever use the hash table (i.e., at least tid+1, where tid is the largest thread ID passed to any function of this class)
  * @param _capacity is the INITIAL size of the hash table (maximum number of elements it can contain WITHOUT expansion)
  */
-AlgorithmA::AlgorithmA(const int _numThreads, const int _capacity)
-: numThreads(_numThreads), capacity(_capacity) {
+template <class CapacityPolicy, class HashPolicy>
+AlgorithmA<CapacityPolicy, HashPolicy>::AlgorithmA(const int _numThreads, const int _capacity)
+: numThreads(_numThreads), capacity(CapacityPolicy::roundUp(_capacity)), slots(capacity) {
     // Allocate some data
     data = new lockedKey[capacity];
 }
 
 // destructor: clean up any allocated memory, etc.
-AlgorithmA::~AlgorithmA() {
+template <class CapacityPolicy, class HashPolicy>
+AlgorithmA<CapacityPolicy, HashPolicy>::~AlgorithmA() {
     delete[] data; // Free our data
 }
 
 // semantics: try to insert key. return true if successful (if key doesn't already exist), and false otherwise
-bool AlgorithmA::insertIfAbsent(const int tid, const int & key) {
-    uint32_t h = murmur3(key);
-    for (int i = 0; i < capacity; ++i){
-        int index = (h+i) % capacity;
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmA<CapacityPolicy, HashPolicy>::insertIfAbsent(const int tid, const int & key) {
+    uint32_t h = HashPolicy::hash(key);
+    int index = slots.home(h);
+    for (int i = 0; i < capacity; ++i, index = slots.next(index)){
         // Lock the data
         data[index].m.lock();
         int found = data[index].key;
@@ -61,7 +67,7 @@ bool AlgorithmA::insertIfAbsent(const int tid, const int & key) {
             data[index].m.unlock();
             return false;
         } else if (found == EMPTY){
-            data[index].key = key;
+            __atomic_store_n(&data[index].key, key, __ATOMIC_RELEASE);
             data[index].m.unlock();
             return true;
         }
@@ -73,17 +79,18 @@ bool AlgorithmA::insertIfAbsent(const int tid, const int & key) {
 }
 
 // semantics: try to erase key. return true if successful, and false otherwise
-bool AlgorithmA::erase(const int tid, const int & key) {
-    uint32_t h = murmur3(key);
-    for (int i = 0; i < capacity; ++i){
-        int index = (h+i) % capacity;
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmA<CapacityPolicy, HashPolicy>::erase(const int tid, const int & key) {
+    uint32_t h = HashPolicy::hash(key);
+    int index = slots.home(h);
+    for (int i = 0; i < capacity; ++i, index = slots.next(index)){
 
 
         data[index].m.lock();
         int found = data[index].key;
         if (found == key){
             // Replace with tombstone
-            data[index].key = TOMBSTONE;
+            __atomic_store_n(&data[index].key, TOMBSTONE, __ATOMIC_RELEASE);
             data[index].m.unlock();
             return true;
         } else if (found == EMPTY){
@@ -96,8 +103,27 @@ bool AlgorithmA::erase(const int tid, const int & key) {
     return false;
 }
 
+// semantics: return true if key is in the set, and false otherwise.
+// takes no locks: a slot only ever goes from EMPTY to a key to TOMBSTONE, so a key has at most one slot,
+// and if it is present, its slot comes before the first EMPTY slot on its probe sequence.
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmA<CapacityPolicy, HashPolicy>::contains(const int tid, const int & key) {
+    uint32_t h = HashPolicy::hash(key);
+    int index = slots.home(h);
+    for (int i = 0; i < capacity; ++i, index = slots.next(index)){
+        int found = __atomic_load_n(&data[index].key, __ATOMIC_ACQUIRE);
+        if (found == key){
+            return true;
+        } else if (found == EMPTY){
+            return false;
+        }
+    }
+    return false;
+}
+
 // semantics: return the sum of all KEYS in the set
-int64_t AlgorithmA::getSumOfKeys() {
+template <class CapacityPolicy, class HashPolicy>
+int64_t AlgorithmA<CapacityPolicy, HashPolicy>::getSumOfKeys() {
     int64_t total = 0;
     for (int index = 0; index < capacity; ++index){
         // Making sure we lock because time doesn't matter here and why not be extra safe
@@ -112,7 +138,8 @@ int64_t AlgorithmA::getSumOfKeys() {
 }
 
 // print any debugging details you want at the end of a trial in this function
-void AlgorithmA::printDebuggingDetails() {
+template <class CapacityPolicy, class HashPolicy>
+void AlgorithmA<CapacityPolicy, HashPolicy>::printDebuggingDetails() {
     /*
     for (int index = 0; index < capacity; ++index){
         data[index].m.lock();
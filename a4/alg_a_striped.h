@@ -0,0 +1,172 @@
+#pragma once
+#include "util.h"
+#include <atomic>
+using namespace std;
+
+#ifndef ALG_A_STRIPE_WIDTH
+#define ALG_A_STRIPE_WIDTH 16 // slots guarded by each versioned lock (16 ints = one 64 byte cache line of keys)
+#endif
+
+/**
+ * Same semantics as AlgorithmA (linear probing, tombstones, no expansion),
+ * but with a compact layout: keys live in a dense int array, and each probe
+ * window of ALG_A_STRIPE_WIDTH consecutive slots is guarded by one versioned
+ * lock (a sequence lock: odd = locked, and every unlock advances the version).
+ *
+ * A slot only ever changes EMPTY -> key -> TOMBSTONE, so operations scan each
+ * window optimistically (no writes to shared memory), validate the window's
+ * version, and only lock it to write one slot. The lock is acquired by
+ * upgrading the validated version, so if that succeeds nothing in the window
+ * changed since it was scanned, and no re-check is needed.
+ *
+ * Memory: 4 bytes per slot plus 4 bytes per window, versus PADDING_BYTES per slot in AlgorithmA.
+ */
+template <class CapacityPolicy = ModuloCapacity>
+class AlgorithmAStriped {
+private:
+    char padding0[PADDING_BYTES];
+    const int numThreads;
+    int capacity;
+    CapacityPolicy slots;
+    int stripeWidth;
+    int numStripes;
+    char padding1[PADDING_BYTES];
+    atomic<int> * keys;
+    atomic<uint32_t> * versions; // one per window
+    char padding2[PADDING_BYTES];
+
+    // wait until the window is unlocked, and return its version
+    uint32_t readBegin(const int stripe) {
+        uint32_t v;
+        int backoff = 1;
+        while ((v = versions[stripe].load(memory_order_acquire)) & 1) {
+            for (int i=0;i<backoff;++i) _mm_pause();
+            if (backoff < 1024) backoff <<= 1;
+        }
+        return v;
+    }
+    bool readValidate(const int stripe, const uint32_t v) {
+        atomic_thread_fence(memory_order_acquire); // keep the key reads before the version re-read
+        return versions[stripe].load(memory_order_relaxed) == v;
+    }
+    // lock the window only if it has not changed since version v was read
+    bool tryUpgrade(const int stripe, uint32_t v) {
+        return versions[stripe].compare_exchange_strong(v, v+1);
+    }
+    void unlock(const int stripe) {
+        versions[stripe].store(versions[stripe].load(memory_order_relaxed) + 1, memory_order_release);
+    }
+
+public:
+    static constexpr int TOMBSTONE = -1;
+    static constexpr int EMPTY = 0;
+
+    AlgorithmAStriped(const int _numThreads, const int _capacity, const int _stripeWidth = ALG_A_STRIPE_WIDTH);
+    ~AlgorithmAStriped();
+    bool insertIfAbsent(const int tid, const int & key);
+    bool erase(const int tid, const int & key);
+    long getSumOfKeys();
+    void printDebuggingDetails();
+};
+
+/**
+ * constructor: initialize the hash table's internals
+ *
+ * @param _numThreads maximum number of threads that will ever use the hash table (i.e., at least tid+1, where tid is the largest thread ID passed to any function of this class)
+ * @param _capacity is the INITIAL size of the hash table (maximum number of elements it can contain WITHOUT expansion)
+ * @param _stripeWidth number of consecutive slots guarded by each versioned lock
+ */
+template <class CapacityPolicy>
+AlgorithmAStriped<CapacityPolicy>::AlgorithmAStriped(const int _numThreads, const int _capacity, const int _stripeWidth)
+: numThreads(_numThreads), capacity(CapacityPolicy::roundUp(_capacity)), slots(capacity), stripeWidth(_stripeWidth) {
+    numStripes = (capacity + stripeWidth - 1) / stripeWidth;
+    keys = new atomic<int>[capacity] {};
+    versions = new atomic<uint32_t>[numStripes] {};
+}
+
+// destructor: clean up any allocated memory, etc.
+template <class CapacityPolicy>
+AlgorithmAStriped<CapacityPolicy>::~AlgorithmAStriped() {
+    delete[] keys;
+    delete[] versions;
+}
+
+// semantics: try to insert key. return true if successful (if key doesn't already exist), and false otherwise
+template <class CapacityPolicy>
+bool AlgorithmAStriped<CapacityPolicy>::insertIfAbsent(const int tid, const int & key) {
+    uint32_t h = murmur3(key);
+    int index = slots.home(h);
+    for (int scanned = 0; scanned < capacity; ) {
+        // probe the part of the window that starts at index
+        int stripe = index / stripeWidth;
+        int end = min((stripe+1) * stripeWidth, capacity);
+        uint32_t v = readBegin(stripe);
+        int i = index;
+        int found = TOMBSTONE;
+        for (; i < end; ++i) {
+            found = keys[i].load(memory_order_relaxed);
+            if (found == key || found == EMPTY) break;
+        }
+        if (!readValidate(stripe, v)) continue; // the window changed while we scanned it: rescan it
+        if (i < end) {
+            if (found == key) return false;
+            // found an EMPTY slot, and nothing before it in the window is our key
+            if (!tryUpgrade(stripe, v)) continue;
+            keys[i].store(key, memory_order_relaxed);
+            unlock(stripe);
+            return true;
+        }
+        scanned += end - index;
+        index = (end == capacity) ? 0 : end;
+    }
+    return false;
+}
+
+// semantics: try to erase key. return true if successful, and false otherwise
+template <class CapacityPolicy>
+bool AlgorithmAStriped<CapacityPolicy>::erase(const int tid, const int & key) {
+    uint32_t h = murmur3(key);
+    int index = slots.home(h);
+    for (int scanned = 0; scanned < capacity; ) {
+        int stripe = index / stripeWidth;
+        int end = min((stripe+1) * stripeWidth, capacity);
+        uint32_t v = readBegin(stripe);
+        int i = index;
+        int found = TOMBSTONE;
+        for (; i < end; ++i) {
+            found = keys[i].load(memory_order_relaxed);
+            if (found == key || found == EMPTY) break;
+        }
+        if (!readValidate(stripe, v)) continue;
+        if (i < end) {
+            if (found == EMPTY) return false;
+            // replace with tombstone
+            if (!tryUpgrade(stripe, v)) continue;
+            keys[i].store(TOMBSTONE, memory_order_relaxed);
+            unlock(stripe);
+            return true;
+        }
+        scanned += end - index;
+        index = (end == capacity) ? 0 : end;
+    }
+    return false;
+}
+
+// semantics: return the sum of all KEYS in the set
+template <class CapacityPolicy>
+int64_t AlgorithmAStriped<CapacityPolicy>::getSumOfKeys() {
+    int64_t total = 0;
+    for (int index = 0; index < capacity; ++index){
+        int key = keys[index];
+        if (key > 0) total += key;
+    }
+    return total;
+}
+
+// print any debugging details you want at the end of a trial in this function
+template <class CapacityPolicy>
+void AlgorithmAStriped<CapacityPolicy>::printDebuggingDetails() {
+    PRINT(stripeWidth);
+    PRINT(numStripes);
+    cout<<"bytes per slot="<<(sizeof(atomic<int>) + sizeof(atomic<uint32_t>) / (double) stripeWidth)<<endl;
+}
@@ -4,6 +4,7 @@
 #include <mutex>
 using namespace std;
 
+template <class CapacityPolicy = ModuloCapacity, class HashPolicy = Murmur3Hash>
 class AlgorithmB {
 public:
     static constexpr int TOMBSTONE = -1;
@@ -21,12 +22,14 @@ public:
     char padding0[PADDING_BYTES];
     const int numThreads;
     int capacity;
+    CapacityPolicy slots;
     char padding2[PADDING_BYTES];
 
     AlgorithmB(const int _numThreads, const int _capacity);
     ~AlgorithmB();
     bool insertIfAbsent(const int tid, const int & key);
     bool erase(const int tid, const int & key);
+    bool contains(const int tid, const int & key);
     long getSumOfKeys();
     void printDebuggingDetails(); 
 };
@@ -37,21 +40,24 @@ public:
  * @param _numThreads maximum number of threads that will ever use the hash table (i.e., at least tid+1, where tid is the largest thread ID passed to any function of this class)
  * @param _capacity is the INITIAL size of the hash table (maximum number of elements it can contain WITHOUT expansion)
  */
-AlgorithmB::AlgorithmB(const int _numThreads, const int _capacity)
-: numThreads(_numThreads), capacity(_capacity) {
+template <class CapacityPolicy, class HashPolicy>
+AlgorithmB<CapacityPolicy, HashPolicy>::AlgorithmB(const int _numThreads, const int _capacity)
+: numThreads(_numThreads), capacity(CapacityPolicy::roundUp(_capacity)), slots(capacity) {
     data = new lockedKey[capacity];   
 }
 
 // destructor: clean up any allocated memory, etc.
-AlgorithmB::~AlgorithmB() {
+template <class CapacityPolicy, class HashPolicy>
+AlgorithmB<CapacityPolicy, HashPolicy>::~AlgorithmB() {
     delete [] data;
 }
 
 // semantics: try to insert key. return true if successful (if key doesn't already exist), and false otherwise
-bool AlgorithmB::insertIfAbsent(const int tid, const int & key) {
-    uint32_t h = murmur3(key);
-    for (int i = 0; i < capacity; ++i){
-        int index = (h+i) % capacity;
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmB<CapacityPolicy, HashPolicy>::insertIfAbsent(const int tid, const int & key) {
+    uint32_t h = HashPolicy::hash(key);
+    int index = slots.home(h);
+    for (int i = 0; i < capacity; ++i, index = slots.next(index)){
         // Lock the data
         
         int found = data[index].key;
@@ -81,10 +87,11 @@ bool AlgorithmB::insertIfAbsent(const int tid, const int & key) {
 }
 
 // semantics: try to erase key. return true if successful, and false otherwise
-bool AlgorithmB::erase(const int tid, const int & key) {
-    uint32_t h = murmur3(key);
-    for (int i = 0; i < capacity; ++i){
-        int index = (h+i) % capacity;
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmB<CapacityPolicy, HashPolicy>::erase(const int tid, const int & key) {
+    uint32_t h = HashPolicy::hash(key);
+    int index = slots.home(h);
+    for (int i = 0; i < capacity; ++i, index = slots.next(index)){
 
 
         int found = data[index].key;
@@ -102,8 +109,26 @@ bool AlgorithmB::erase(const int tid, const int & key) {
     return false;
 }
 
+// semantics: return true if key is in the set, and false otherwise.
+// like the unlocked part of insertIfAbsent and erase, this takes no locks
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmB<CapacityPolicy, HashPolicy>::contains(const int tid, const int & key) {
+    uint32_t h = HashPolicy::hash(key);
+    int index = slots.home(h);
+    for (int i = 0; i < capacity; ++i, index = slots.next(index)){
+        int found = __atomic_load_n(&data[index].key, __ATOMIC_ACQUIRE);
+        if (found == key){
+            return true;
+        } else if (found == EMPTY){
+            return false;
+        }
+    }
+    return false;
+}
+
 // semantics: return the sum of all KEYS in the set
-int64_t AlgorithmB::getSumOfKeys() {
+template <class CapacityPolicy, class HashPolicy>
+int64_t AlgorithmB<CapacityPolicy, HashPolicy>::getSumOfKeys() {
     int64_t total = 0;
     for (int index = 0; index < capacity; ++index){
         // Making sure we lock because time doesn't matter here and why not be extra safe
@@ -118,6 +143,7 @@ int64_t AlgorithmB::getSumOfKeys() {
 }
 
 // print any debugging details you want at the end of a trial in this function
-void AlgorithmB::printDebuggingDetails() {
+template <class CapacityPolicy, class HashPolicy>
+void AlgorithmB<CapacityPolicy, HashPolicy>::printDebuggingDetails() {
     
 }
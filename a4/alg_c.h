@@ -1,98 +1,505 @@
 #pragma once
 #include "util.h"
+#include "tombstone_purge.h"
 #include <atomic>
+// debugprinting.h (in the record manager) defines TRACE, so keep the TRACE that benchmark_debug passes with -D
+#pragma push_macro("TRACE")
+#undef TRACE
+#include "../a5/recordmgr/record_manager.h"
+#pragma pop_macro("TRACE")
 using namespace std;
 
+/**
+ * Lock-free linear probing set that never expands. Erased keys stay in their slots (as tombstones),
+ * and once there are too many of them, the table is purged cooperatively, by migrating its live keys
+ * into a new table of the same capacity (tombstone_purge.h). The old table is retired to the (DEBRA)
+ * record manager, which frees it once every thread has finished the operation it was in.
+ */
+template <class CapacityPolicy = ModuloCapacity, class HashPolicy = Murmur3Hash>
 class AlgorithmC {
+private:
+    enum {
+        MARKED_MASK = PurgeableTable::MARKED_MASK,
+        DELETED_MASK = PurgeableTable::DELETED_MASK,
+        KEY_MASK = PurgeableTable::KEY_MASK,
+        EMPTY = PurgeableTable::EMPTY
+    };
+
+    struct table : PurgeableTable {
+        char padding0[PADDING_BYTES];
+        atomic<int> * data;
+        atomic<int> * old;              // oldTable->data
+        table * oldTable;
+        char padding1[PADDING_BYTES];
+        // the record manager default constructs records, and then we construct them in place (placement new)
+        table() : data(nullptr), old(nullptr), oldTable(nullptr) {}
+        table(int numThreads, int capacity, int insertLimit, table * oldT)
+        : PurgeableTable(numThreads, capacity, oldT ? capacity : 0, insertLimit), oldTable(oldT) {
+            data = new atomic<int>[capacity] {};
+            old = oldT ? oldT->data : nullptr;
+        }
+        ~table() {
+            // old belongs to oldTable, which is retired separately
+            if (data != nullptr) delete [] data;
+        }
+    };
+
+    // the most keys that inserts can still add to a table that is being purged (one per operation or batch lane in flight)
+    int64_t inFlightInserts() {
+        return (int64_t) numThreads * BATCH_INFLIGHT;
+    }
+
+    table * newTable(const int tid, int insertLimit, table * oldT);
+    bool purgeAsNeeded(const int tid, table * t, int probes);
+    bool startPurge(const int tid, table * t);
+    void helpMigration(const int tid, table * t);
+    void finishMigration(const int tid, table * t);
+    bool migrateSlot(const int tid, table * t, int index);
+    void migrateKey(const int tid, table * t, int key);
+    bool copyKey(const int tid, table * t, int key);
+    // the operations, for a key whose hash is h. the caller must hold a tablemgr guard.
+    bool insertHashed(const int tid, const int key, const uint32_t h);
+    bool eraseHashed(const int tid, const int key, const uint32_t h);
+    bool containsHashed(const int tid, const int key, const uint32_t h);
+    // one probe of an operation on key at slot index of tab, which is its probes'th slot (for batches):
+    // STEP_DONE once the operation is resolved (and result is set), STEP_NEXT if it must continue at the
+    // next slot, or STEP_SLOW if it must be redone by the operation above (to purge, or to move to a new table)
+    enum stepResult { STEP_DONE, STEP_NEXT, STEP_SLOW };
+    stepResult insertStep(const int tid, table * tab, const int key, const int index, const int probes, bool & result);
+    stepResult eraseStep(const int tid, table * tab, const int key, const int index, const int probes, bool & result);
+    stepResult containsStep(const int tid, table * tab, const int key, const int index, const int probes, bool & result);
+    template <class Step, class Op>
+    void runBatch(const int tid, const int * keys, const int n, bool * out, Step step, Op op);
+
     char padding1[PADDING_BYTES];
-    atomic<int>* data;
+    atomic<table *> currentTable;
+    char padding3[PADDING_BYTES];
+    simple_record_manager<table> tablemgr;
+    char padding4[PADDING_BYTES];
+    atomic<int> numPurges;
 public:
-    static constexpr int TOMBSTONE = -1;
-    static constexpr int EMPTY = 0;
+    static constexpr int MAX_KEY = KEY_MASK; // keys must be in [1, MAX_KEY]
 
     char padding0[PADDING_BYTES];
     const int numThreads;
     int capacity;
+    CapacityPolicy slots;
     char padding2[PADDING_BYTES];
 
     AlgorithmC(const int _numThreads, const int _capacity);
     ~AlgorithmC();
     bool insertIfAbsent(const int tid, const int & key);
     bool erase(const int tid, const int & key);
+    bool contains(const int tid, const int & key);
+    void insertBatch(const int tid, const int * keys, const int n, bool * out);
+    void eraseBatch(const int tid, const int * keys, const int n, bool * out);
+    void containsBatch(const int tid, const int * keys, const int n, bool * out);
     long getSumOfKeys();
-    void printDebuggingDetails(); 
+    void printDebuggingDetails();
 };
 
 /**
  * constructor: initialize the hash table's internals
- * 
+ *
  * @param _numThreads maximum number of threads that will ever use the hash table (i.e., at least tid+1, where tid is the largest thread ID passed to any function of this class)
  * @param _capacity is the INITIAL size of the hash table (maximum number of elements it can contain WITHOUT expansion)
  */
-AlgorithmC::AlgorithmC(const int _numThreads, const int _capacity)
-: numThreads(_numThreads), capacity(_capacity) {
-    data = new atomic<int>[capacity] {};
+template <class CapacityPolicy, class HashPolicy>
+AlgorithmC<CapacityPolicy, HashPolicy>::AlgorithmC(const int _numThreads, const int _capacity)
+: tablemgr(MAX_THREADS), numPurges(0), numThreads(_numThreads), capacity(CapacityPolicy::roundUp(_capacity)), slots(capacity) {
+    currentTable = newTable(0, capacity, nullptr);
 }
 
 // destructor: clean up any allocated memory, etc.
-AlgorithmC::~AlgorithmC() {
-    delete [] data;
+template <class CapacityPolicy, class HashPolicy>
+AlgorithmC<CapacityPolicy, HashPolicy>::~AlgorithmC() {
+    // older tables were retired, and are freed by tablemgr's destructor
+    table * t = currentTable;
+    if (t->oldTable != nullptr) tablemgr.deallocate(0, t->oldTable);
+    tablemgr.deallocate(0, t);
+}
+
+template <class CapacityPolicy, class HashPolicy>
+typename AlgorithmC<CapacityPolicy, HashPolicy>::table * AlgorithmC<CapacityPolicy, HashPolicy>::newTable(const int tid, int insertLimit, table * oldT) {
+    return new (tablemgr.template allocate<table>(tid)) table(numThreads, capacity, insertLimit, oldT);
+}
+
+// start purging t if it has too many tombstones, or help the purge that is replacing t.
+// returns true if the caller must restart its operation in the current table
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmC<CapacityPolicy, HashPolicy>::purgeAsNeeded(const int tid, table * t, int probes) {
+    if (t->replacing || t->isPurgeNeeded(probes)) return startPurge(tid, t);
+    return false;
+}
+
+// replace t with a new table that holds only t's live keys (if t is still current, and the accurate count
+// of its deleted slots agrees). returns true if the caller must restart its operation in the current table
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmC<CapacityPolicy, HashPolicy>::startPurge(const int tid, table * t) {
+    bool purged = replaceTable(tid, currentTable, tablemgr, t, [&]() {
+        return t->shouldPurge(capacity);
+    }, [&]() {
+        // t->replacing is set, so the migration copies at most the keys that are live in t now, plus the in-flight inserts
+        return newTable(tid, PurgeableTable::insertLimitFor(capacity, PurgeableTable::countLive(t->data, capacity) + inFlightInserts()), t);
+    }, [&](table * newT, int index) { return migrateSlot(tid, newT, index); });
+    if (purged) numPurges.fetch_add(1);
+    return purged || currentTable != t;
+}
+
+// claim and migrate one chunk of t's old table (if any are left to claim)
+template <class CapacityPolicy, class HashPolicy>
+void AlgorithmC<CapacityPolicy, HashPolicy>::helpMigration(const int tid, table * t) {
+    t->helpMigration([&](int index) { return migrateSlot(tid, t, index); });
+}
+
+// migrate every chunk of t's old table that isn't finished, including chunks claimed by other threads
+template <class CapacityPolicy, class HashPolicy>
+void AlgorithmC<CapacityPolicy, HashPolicy>::finishMigration(const int tid, table * t) {
+    t->finishMigration([&](int index) { return migrateSlot(tid, t, index); });
+}
+
+// freeze slot index of t's old table, and copy its key into t if it is live. idempotent.
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmC<CapacityPolicy, HashPolicy>::migrateSlot(const int tid, table * t, int index) {
+    return PurgeableTable::migrateSlot(t->old, index, [&](int key) { return copyKey(tid, t, key); });
+}
+
+// make sure that, if key is in t's old table, it has been migrated (read-through for operations on key in t)
+template <class CapacityPolicy, class HashPolicy>
+void AlgorithmC<CapacityPolicy, HashPolicy>::migrateKey(const int tid, table * t, int key) {
+    int index = slots.home(HashPolicy::hash(key));
+    for (int i = 0; i < capacity; ++i, index = slots.next(index)){
+        int found = t->old[index];
+        while (found == EMPTY) {
+            // freeze the end of key's probe sequence, so key can't be inserted into the old table behind our back
+            if (t->old[index].compare_exchange_strong(found, found | MARKED_MASK)) return;
+            // someone inserted here: look again
+        }
+        if ((found & KEY_MASK) == key){
+            migrateSlot(tid, t, index);
+            return;
+        } else if ((found & KEY_MASK) == EMPTY){
+            return; // already frozen
+        }
+    }
+}
+
+// insert key into t, unless t already has a slot for key (live or deleted).
+// returns false if t is full (which the room reserved for the migration rules out)
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmC<CapacityPolicy, HashPolicy>::copyKey(const int tid, table * t, int key) {
+    int index = slots.home(HashPolicy::hash(key));
+    for (int i = 0; i < capacity; ++i, index = slots.next(index)){
+        int found = t->data[index];
+        while ((found & KEY_MASK) == EMPTY && !(found & MARKED_MASK)) {
+            if (t->data[index].compare_exchange_strong(found, key)) return true;
+        }
+        if ((found & KEY_MASK) == key || (found & KEY_MASK) == EMPTY) return true; // already copied (or t was purged after we were delayed)
+    }
+    return false;
 }
 
 // semantics: try to insert key. return true if successful (if key doesn't already exist), and false otherwise
-bool AlgorithmC::insertIfAbsent(const int tid, const int & key) {
-    uint32_t h = murmur3(key);
-    for (int i = 0; i < capacity; ++i){
-        int index = (h+i) % capacity;
-        // Lock the data
-        int found = data[index];
-        if (found == key){
-            return false;
-        } else if (found == EMPTY){
-            int expected = EMPTY;
-            // Attempt a CAS
-            if (data[index].compare_exchange_strong(expected, key)){
-                return true;
-            } else if (expected == key){ // data[index] == key the expected should have an updated value
+// (including when the table has no EMPTY slot for key)
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmC<CapacityPolicy, HashPolicy>::insertIfAbsent(const int tid, const int & key) {
+    auto guard = tablemgr.getGuard(tid); // tables we reach can't be freed until guard goes out of scope
+    return insertHashed(tid, key, HashPolicy::hash(key));
+}
+
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmC<CapacityPolicy, HashPolicy>::insertHashed(const int tid, const int key, const uint32_t h) {
+retry:
+    table * tab = currentTable;
+    if (tab->isMigrating()) {
+        helpMigration(tid, tab);
+        migrateKey(tid, tab, key);
+    }
+
+    int index = slots.home(h);
+    for (int i = 0; i < capacity; ++i, index = slots.next(index)){
+        if (i == 0 || i == 11) {
+            if (purgeAsNeeded(tid, tab, i)) goto retry;
+        }
+        int found = tab->data[index];
+        while (true) {
+            if (found & MARKED_MASK) {
+                // tab is being purged: restart in the new table
+                goto retry;
+            } else if ((found & KEY_MASK) == key) {
+                if (!(found & DELETED_MASK)) return false; // already here
+                // revive our deleted slot
+                if (tab->data[index].compare_exchange_strong(found, key)) {
+                    tab->approxRevives->inc(tid);
+                    return true;
+                }
+            } else if (found == EMPTY) {
+                if (!tab->claimForInsert()) {
+                    // the rest of tab's room is for the keys it is migrating: finish that (never waits), then retry
+                    finishMigration(tid, tab);
+                    goto retry;
+                }
+                if (tab->data[index].compare_exchange_strong(found, key)) return true;
+            } else {
+                break; // another key's slot, so we continue
+            }
+            // CAS failed. found now contains the found value
+        }
+    }
+
+    if (currentTable != tab) goto retry; // tab was replaced while we probed it
+    return false; // no EMPTY slot for key (there aren't enough tombstones to purge yet)
+}
+
+// semantics: try to erase key. return true if successful, and false otherwise
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmC<CapacityPolicy, HashPolicy>::erase(const int tid, const int & key) {
+    auto guard = tablemgr.getGuard(tid);
+    return eraseHashed(tid, key, HashPolicy::hash(key));
+}
+
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmC<CapacityPolicy, HashPolicy>::eraseHashed(const int tid, const int key, const uint32_t h) {
+retry:
+    table * tab = currentTable;
+    if (tab->isMigrating()) {
+        helpMigration(tid, tab);
+        migrateKey(tid, tab, key); // keys that have not been migrated yet are not visible in tab
+    }
+
+    int index = slots.home(h);
+    for (int i = 0; i < capacity; ++i, index = slots.next(index)){
+        int found = tab->data[index];
+        while (true) {
+            if (found & MARKED_MASK) {
+                // tab is being purged: restart in the new table
+                goto retry;
+            } else if ((found & KEY_MASK) == key) {
+                if (found & DELETED_MASK) return false;
+                if (tab->data[index].compare_exchange_strong(found, found | DELETED_MASK)) {
+                    tab->approxDeletes->inc(tid);
+                    return true;
+                }
+            } else if (found == EMPTY) {
                 return false;
+            } else {
+                break; // another key's slot, so we continue
             }
         }
     }
     return false;
 }
 
-// semantics: try to erase key. return true if successful, and false otherwise
-bool AlgorithmC::erase(const int tid, const int & key) {
-    uint32_t h = murmur3(key);
-    for (int i = 0; i < capacity; ++i){
-        int index = (h+i) % capacity;
-        // Lock the data
-        int found = data[index];
-
-        if (found == EMPTY){
+// semantics: return true if key is in the set, and false otherwise. lock-free, and never writes to the table.
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmC<CapacityPolicy, HashPolicy>::contains(const int tid, const int & key) {
+    auto guard = tablemgr.getGuard(tid);
+    return containsHashed(tid, key, HashPolicy::hash(key));
+}
+
+// a lookup never migrates anything: if tab is migrating, a key that has no slot in tab yet is read from tab's old table
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmC<CapacityPolicy, HashPolicy>::containsHashed(const int tid, const int key, const uint32_t h) {
+retry:
+    table * tab = currentTable;
+    bool oldSlotFinal = false; // key's slot in the old table is migrated (or gone), so tab has the last word on key
+scan:
+    int index = slots.home(h);
+    for (int i = 0; i < capacity; ++i, index = slots.next(index)){
+        int found = tab->data[index];
+        if (found & MARKED_MASK) {
+            if ((found & KEY_MASK) == key || (found & KEY_MASK) == EMPTY) goto retry; // tab has been replaced
+        } else if ((found & KEY_MASK) == key) {
+            return !(found & DELETED_MASK);
+        } else if (found == EMPTY) {
+            break;
+        }
+    }
+    if (oldSlotFinal || !tab->isMigrating()) return false;
+
+    // key has no slot in tab (yet), so if it is anywhere, it is in the old table
+    index = slots.home(h);
+    for (int i = 0; i < capacity; ++i, index = slots.next(index)){
+        int found = tab->old[index];
+        if ((found & KEY_MASK) == key) {
+            if ((found & (MARKED_MASK | DELETED_MASK)) == (MARKED_MASK | DELETED_MASK)) {
+                // either key was copied into tab since we looked, or it was erased before the purge
+                oldSlotFinal = true;
+                goto scan;
+            }
+            return !(found & DELETED_MASK); // frozen but not copied yet, or not migrated yet
+        } else if ((found & KEY_MASK) == EMPTY) {
             return false;
-        } else if (found == key){
-            int expected = key;
-            return (data[index].compare_exchange_strong(expected, TOMBSTONE));
         }
     }
     return false;
 }
 
+template <class CapacityPolicy, class HashPolicy>
+typename AlgorithmC<CapacityPolicy, HashPolicy>::stepResult AlgorithmC<CapacityPolicy, HashPolicy>::insertStep(const int tid, table * tab, const int key, const int index, const int probes, bool & result) {
+    // insertHashed checks whether to purge (or help purge tab) at these probes
+    if ((probes == 0 && (tab->replacing || tab->isPurgeNeeded(probes))) || probes > 10) return STEP_SLOW;
+    int found = tab->data[index];
+    while (true) {
+        if (found & MARKED_MASK) {
+            return STEP_SLOW;
+        } else if ((found & KEY_MASK) == key) {
+            if (!(found & DELETED_MASK)) {
+                result = false;
+                return STEP_DONE;
+            }
+            if (tab->data[index].compare_exchange_strong(found, key)) {
+                tab->approxRevives->inc(tid);
+                result = true;
+                return STEP_DONE;
+            }
+        } else if (found == EMPTY) {
+            if (tab->data[index].compare_exchange_strong(found, key)) {
+                result = true;
+                return STEP_DONE;
+            }
+        } else {
+            return STEP_NEXT;
+        }
+    }
+}
+
+template <class CapacityPolicy, class HashPolicy>
+typename AlgorithmC<CapacityPolicy, HashPolicy>::stepResult AlgorithmC<CapacityPolicy, HashPolicy>::eraseStep(const int tid, table * tab, const int key, const int index, const int probes, bool & result) {
+    int found = tab->data[index];
+    while (true) {
+        if (found & MARKED_MASK) {
+            return STEP_SLOW;
+        } else if ((found & KEY_MASK) == key) {
+            if (found & DELETED_MASK) {
+                result = false;
+                return STEP_DONE;
+            }
+            if (tab->data[index].compare_exchange_strong(found, found | DELETED_MASK)) {
+                tab->approxDeletes->inc(tid);
+                result = true;
+                return STEP_DONE;
+            }
+        } else if (found == EMPTY) {
+            result = false;
+            return STEP_DONE;
+        } else {
+            return STEP_NEXT;
+        }
+    }
+}
+
+template <class CapacityPolicy, class HashPolicy>
+typename AlgorithmC<CapacityPolicy, HashPolicy>::stepResult AlgorithmC<CapacityPolicy, HashPolicy>::containsStep(const int tid, table * tab, const int key, const int index, const int probes, bool & result) {
+    int found = tab->data[index];
+    if (found & MARKED_MASK) {
+        if ((found & KEY_MASK) == key || (found & KEY_MASK) == EMPTY) return STEP_SLOW; // tab has been replaced
+    } else if ((found & KEY_MASK) == key) {
+        result = !(found & DELETED_MASK);
+        return STEP_DONE;
+    } else if (found == EMPTY) {
+        result = false;
+        return STEP_DONE;
+    }
+    return STEP_NEXT;
+}
+
+/**
+ * Batched operations (asynchronous memory access chaining): up to BATCH_INFLIGHT keys are in flight,
+ * each in its own lane that remembers the table it is probing, and the key's current slot and probe count.
+ * We prefetch a lane's slot when it starts (or moves to) that slot, and come back to it only after stepping
+ * every other lane, so its cache miss overlaps the others'. When a lane's key is resolved, the lane takes the
+ * next key. out[i] gets the result of the operation on keys[i].
+ *
+ * The steps only handle the common case: a table that is not migrating, and no purge. A key whose table is
+ * migrating, or whose step returns STEP_SLOW, is done by the (unbatched) operation instead, which restarts it
+ * from the current table.
+ */
+template <class CapacityPolicy, class HashPolicy>
+template <class Step, class Op>
+void AlgorithmC<CapacityPolicy, HashPolicy>::runBatch(const int tid, const int * keys, const int n, bool * out, Step step, Op op) {
+    auto guard = tablemgr.getGuard(tid); // one guard for the batch, so the tables that lanes are probing can't be freed under us
+    struct lane {
+        int which;      // index into keys (and out), or -1 if the lane is idle
+        uint32_t h;
+        table * tab;
+        int index;
+        int probes;
+    } lanes[BATCH_INFLIGHT];
+    int next = 0;
+    auto start = [&](lane & l) {
+        while (next < n) {
+            l.which = next++;
+            l.h = HashPolicy::hash(keys[l.which]);
+            l.tab = currentTable;
+            if (!l.tab->isMigrating()) {
+                l.index = slots.home(l.h);
+                l.probes = 0;
+                __builtin_prefetch(&l.tab->data[l.index], 1);
+                return;
+            }
+            out[l.which] = (this->*op)(tid, keys[l.which], l.h); // reads through to (and helps migrate) the old table
+        }
+        l.which = -1;
+    };
+
+    int active = 0;
+    for (int i = 0; i < BATCH_INFLIGHT; ++i) {
+        start(lanes[i]);
+        if (lanes[i].which >= 0) ++active;
+    }
+    while (active > 0) {
+        for (int i = 0; i < BATCH_INFLIGHT; ++i) {
+            lane & l = lanes[i];
+            if (l.which < 0) continue;
+            bool result = false;
+            stepResult r = (l.probes == capacity) ? STEP_SLOW : (this->*step)(tid, l.tab, keys[l.which], l.index, l.probes, result);
+            if (r == STEP_NEXT) {
+                ++l.probes;
+                l.index = slots.next(l.index);
+                __builtin_prefetch(&l.tab->data[l.index], 1);
+                continue;
+            }
+            out[l.which] = (r == STEP_DONE) ? result : (this->*op)(tid, keys[l.which], l.h);
+            start(l);
+            if (l.which < 0) --active;
+        }
+    }
+}
+
+template <class CapacityPolicy, class HashPolicy>
+void AlgorithmC<CapacityPolicy, HashPolicy>::insertBatch(const int tid, const int * keys, const int n, bool * out) {
+    runBatch(tid, keys, n, out, &AlgorithmC::insertStep, &AlgorithmC::insertHashed);
+}
+
+template <class CapacityPolicy, class HashPolicy>
+void AlgorithmC<CapacityPolicy, HashPolicy>::eraseBatch(const int tid, const int * keys, const int n, bool * out) {
+    runBatch(tid, keys, n, out, &AlgorithmC::eraseStep, &AlgorithmC::eraseHashed);
+}
+
+template <class CapacityPolicy, class HashPolicy>
+void AlgorithmC<CapacityPolicy, HashPolicy>::containsBatch(const int tid, const int * keys, const int n, bool * out) {
+    runBatch(tid, keys, n, out, &AlgorithmC::containsStep, &AlgorithmC::containsHashed);
+}
+
 // semantics: return the sum of all KEYS in the set
-int64_t AlgorithmC::getSumOfKeys() {
+template <class CapacityPolicy, class HashPolicy>
+int64_t AlgorithmC<CapacityPolicy, HashPolicy>::getSumOfKeys() {
+    auto guard = tablemgr.getGuard(0);
+    // finish any purge that is still in progress
+    table * t = currentTable;
+    finishMigration(0, t);
+
     int64_t total = 0;
     for (int index = 0; index < capacity; ++index){
-        // Making sure we lock because time doesn't matter here and why not be extra safe
-        // It shouldn't be needed but it's nice to double check
-        if(data[index] > 0){
-            total += data[index];
-        }
+        int found = t->data[index];
+        if (!(found & (DELETED_MASK | MARKED_MASK))) total += found;
     }
     return total;
 }
 
 // print any debugging details you want at the end of a trial in this function
-void AlgorithmC::printDebuggingDetails() {
-    
+template <class CapacityPolicy, class HashPolicy>
+void AlgorithmC<CapacityPolicy, HashPolicy>::printDebuggingDetails() {
+    PRINT(numPurges);
 }
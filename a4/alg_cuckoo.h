@@ -0,0 +1,383 @@
+#pragma once
+#include "util.h"
+#include <atomic>
+#include <vector>
+using namespace std;
+
+#ifndef CUCKOO_SLOTS_PER_BUCKET
+#define CUCKOO_SLOTS_PER_BUCKET 4       // keys per bucket (4 ints = 16 bytes, so a bucket never straddles a cache line)
+#endif
+#ifndef CUCKOO_NUM_STRIPES
+#define CUCKOO_NUM_STRIPES 4096         // versioned locks, each guarding the buckets b with b % CUCKOO_NUM_STRIPES == stripe
+#endif
+#ifndef CUCKOO_MAX_PATH
+#define CUCKOO_MAX_PATH 5               // most keys a single insert will displace
+#endif
+#ifndef CUCKOO_MAX_BFS_NODES
+#define CUCKOO_MAX_BFS_NODES 512        // most buckets one search for a cuckoo path will visit
+#endif
+#ifndef CUCKOO_MAX_LOAD
+#define CUCKOO_MAX_LOAD 0.9             // expand once more than this fraction of the slots hold keys
+#endif
+
+/**
+ * Two-choice bucketized cuckoo hashing (in the style of libcuckoo). Every key lives in one of
+ * two buckets of CUCKOO_SLOTS_PER_BUCKET slots, so a lookup reads at most two buckets, no matter
+ * how full the table is. There are no tombstones: erase just empties the key's slot.
+ *
+ * Synchronization, as in AlgorithmAStriped: each bucket is guarded by one of CUCKOO_NUM_STRIPES
+ * versioned locks (odd = locked). Lookups take no locks: they read both buckets, and retry if
+ * either version changed (or the table was replaced). Updates search first, like
+ * AlgorithmRobinHood, and only lock (both stripes, in increasing order) if there is work to do.
+ *
+ * If both of a key's buckets are full, insert looks for a cuckoo path with a breadth first
+ * search (without locks): a chain of at most CUCKOO_MAX_PATH keys, each of which can move to its
+ * other bucket, ending at a bucket with a free slot. The path is then carried out from its end,
+ * one move at a time, and each move locks its two stripes and re-checks that it is still valid.
+ * (A move never changes the set, so a path that goes stale half way is simply abandoned.)
+ *
+ * Expansion: approxInserts and approxDeletes count updates (like TLEHashTableExpand), and the
+ * table doubles once they say it is more than CUCKOO_MAX_LOAD full, or when no cuckoo path exists.
+ * The expanding thread holds every stripe lock while it rehashes. Old tables are kept until the
+ * destructor, since lock-free lookups may still be reading them (doubling bounds their total size
+ * by the size of the current table).
+ */
+template <class CapacityPolicy = ModuloCapacity>
+class AlgorithmCuckoo {
+private:
+    static const int SLOTS = CUCKOO_SLOTS_PER_BUCKET;
+    static const int MAX_BFS_NODES = CUCKOO_MAX_BFS_NODES;
+    static const int64_t SIZE_STALENESS_NS = 1000000; // how stale a size estimate can be when deciding to expand
+
+    struct table {
+        atomic<int> * keys;             // bucket b is keys[b*SLOTS ... b*SLOTS + SLOTS-1]
+        int numBuckets;
+        CapacityPolicy buckets;         // maps hashes to buckets
+        int64_t maxSize;                // CUCKOO_MAX_LOAD of the slots
+        table(int _numBuckets) : numBuckets(_numBuckets), buckets(_numBuckets) {
+            keys = new atomic<int>[(int64_t) numBuckets * SLOTS] {};
+            maxSize = (int64_t) (CUCKOO_MAX_LOAD * numBuckets * SLOTS);
+        }
+        ~table() {
+            delete[] keys;
+        }
+    };
+
+    // one node of the breadth first search for a cuckoo path
+    struct bfsNode {
+        int bucket;
+        int parent;                     // index of the node whose bucket the key moves out of (-1 for the key's own buckets)
+        int slot;                       // slot (in the parent's bucket) of the key that moves into bucket
+        int depth;
+    };
+
+    char padding0[PADDING_BYTES];
+    const int numThreads;
+    counter * approxInserts;
+    counter * approxDeletes;
+    vector<table *> retired;            // replaced tables (only touched while holding every stripe lock)
+    int numExpansions;
+    char padding1[PADDING_BYTES];
+    atomic<table *> current;
+    char padding2[PADDING_BYTES];
+    atomic<uint32_t> * versions;        // one per stripe
+    char padding3[PADDING_BYTES];
+
+    static int stripeOf(const int bucket) { return bucket % CUCKOO_NUM_STRIPES; }
+    static uint32_t hash2(const uint32_t h1) { return murmur3(h1); }
+    // the bucket (of key's two) that key is NOT in, given that it is in bucket b
+    static int otherBucket(table * t, const int key, const int b) {
+        uint32_t h1 = murmur3(key);
+        int b1 = t->buckets.home(h1);
+        return (b1 == b) ? t->buckets.home(hash2(h1)) : b1;
+    }
+
+    // wait until the stripe is unlocked, and return its version
+    uint32_t readBegin(const int stripe) {
+        uint32_t v;
+        SpinThenPark waiter;
+        while ((v = versions[stripe].load(memory_order_acquire)) & 1) waiter.wait();
+        return v;
+    }
+    void lock(const int stripe) {
+        while (true) {
+            uint32_t v = readBegin(stripe);
+            if (versions[stripe].compare_exchange_strong(v, v+1)) return;
+        }
+    }
+    void unlock(const int stripe) {
+        versions[stripe].store(versions[stripe].load(memory_order_relaxed) + 1, memory_order_release);
+    }
+    // lock the stripes of buckets b1 and b2 (in increasing order). fails (holding nothing) if t has been replaced.
+    bool lockBuckets(table * t, const int b1, const int b2) {
+        int s1 = min(stripeOf(b1), stripeOf(b2));
+        int s2 = max(stripeOf(b1), stripeOf(b2));
+        lock(s1);
+        if (s2 != s1) lock(s2);
+        if (current.load(memory_order_relaxed) == t) return true;
+        unlockBuckets(b1, b2);
+        return false;
+    }
+    void unlockBuckets(const int b1, const int b2) {
+        if (stripeOf(b2) != stripeOf(b1)) unlock(stripeOf(b2));
+        unlock(stripeOf(b1));
+    }
+
+    // slot of key in bucket b (or of an EMPTY slot, if key is EMPTY), or -1
+    int findInBucket(table * t, const int b, const int key) {
+        for (int s = 0; s < SLOTS; ++s) {
+            if (t->keys[b*SLOTS + s].load(memory_order_relaxed) == key) return s;
+        }
+        return -1;
+    }
+
+    bool isExpandNeeded(table * t) {
+        return approxInserts->readWithin(SIZE_STALENESS_NS) - approxDeletes->readWithin(SIZE_STALENESS_NS) > t->maxSize;
+    }
+    bool isExpandNeededAccurate(table * t) {
+        return approxInserts->getAccurate() - approxDeletes->getAccurate() > t->maxSize;
+    }
+    void expand(const int tid, table * t, const bool noPath);
+    bool place(table * t, const int key, const bool locking);
+    int findPath(table * t, const int b1, const int b2, bfsNode * nodes);
+    bool movePath(table * t, bfsNode * nodes, int node, const bool locking);
+
+public:
+    static constexpr int EMPTY = 0;
+
+    AlgorithmCuckoo(const int _numThreads, const int _capacity);
+    ~AlgorithmCuckoo();
+    bool insertIfAbsent(const int tid, const int & key);
+    bool erase(const int tid, const int & key);
+    bool contains(const int tid, const int & key);
+    long getSumOfKeys();
+    void printDebuggingDetails();
+};
+
+/**
+ * constructor: initialize the hash table's internals
+ *
+ * @param _numThreads maximum number of threads that will ever use the hash table (i.e., at least tid+1, where tid is the largest thread ID passed to any function of this class)
+ * @param _capacity is the INITIAL size of the hash table (number of slots, which is rounded up to whole buckets)
+ */
+template <class CapacityPolicy>
+AlgorithmCuckoo<CapacityPolicy>::AlgorithmCuckoo(const int _numThreads, const int _capacity)
+: numThreads(_numThreads), numExpansions(0) {
+    approxInserts = new counter(numThreads);
+    approxDeletes = new counter(numThreads);
+    versions = new atomic<uint32_t>[CUCKOO_NUM_STRIPES] {};
+    current = new table(CapacityPolicy::roundUp(max(1, (_capacity + SLOTS - 1) / SLOTS)));
+}
+
+// destructor: clean up any allocated memory, etc.
+template <class CapacityPolicy>
+AlgorithmCuckoo<CapacityPolicy>::~AlgorithmCuckoo() {
+    for (table * t : retired) delete t;
+    delete current.load();
+    delete[] versions;
+    delete approxInserts;
+    delete approxDeletes;
+}
+
+// breadth first search (without locks) from buckets b1 and b2 for a bucket with an EMPTY slot.
+// returns the index of that bucket's node in nodes (follow parents back to b1 or b2), or -1 if there is none.
+template <class CapacityPolicy>
+int AlgorithmCuckoo<CapacityPolicy>::findPath(table * t, const int b1, const int b2, bfsNode * nodes) {
+    int head = 0;
+    int tail = 0;
+    nodes[tail++] = {b1, -1, -1, 0};
+    if (b2 != b1) nodes[tail++] = {b2, -1, -1, 0};
+    while (head < tail) {
+        int n = head++;
+        int b = nodes[n].bucket;
+        if (nodes[n].depth > 0 && findInBucket(t, b, EMPTY) >= 0) return n;
+        if (nodes[n].depth == CUCKOO_MAX_PATH) continue;
+        for (int s = 0; s < SLOTS && tail < MAX_BFS_NODES; ++s) {
+            int key = t->keys[b*SLOTS + s].load(memory_order_relaxed);
+            if (key == EMPTY) return n; // freed up since we first looked
+            nodes[tail++] = {otherBucket(t, key, b), n, s, nodes[n].depth + 1};
+        }
+    }
+    return -1;
+}
+
+// carry out the cuckoo path that ends at nodes[node], from its end, so every move is into a free slot.
+// returns false if the path went stale (a move found its key gone or its destination full).
+template <class CapacityPolicy>
+bool AlgorithmCuckoo<CapacityPolicy>::movePath(table * t, bfsNode * nodes, int node, const bool locking) {
+    for (; nodes[node].parent >= 0; node = nodes[node].parent) {
+        int to = nodes[node].bucket;
+        int from = nodes[nodes[node].parent].bucket;
+        int fromIndex = from*SLOTS + nodes[node].slot;
+        if (locking && !lockBuckets(t, from, to)) return false;
+        int key = t->keys[fromIndex].load(memory_order_relaxed);
+        int toSlot = findInBucket(t, to, EMPTY);
+        bool ok = (key == EMPTY) || (toSlot >= 0 && otherBucket(t, key, from) == to);
+        if (key != EMPTY && ok) {
+            // the key is in both buckets for a moment, but only while both are locked
+            t->keys[to*SLOTS + toSlot].store(key, memory_order_relaxed);
+            t->keys[fromIndex].store(EMPTY, memory_order_relaxed);
+        }
+        if (locking) unlockBuckets(from, to);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+// put key (which is not in t) into one of its buckets, moving other keys along a cuckoo path if needed.
+// if locking is false, t must be private to the caller. returns false if there is no room.
+template <class CapacityPolicy>
+bool AlgorithmCuckoo<CapacityPolicy>::place(table * t, const int key, const bool locking) {
+    uint32_t h1 = murmur3(key);
+    int b1 = t->buckets.home(h1);
+    int b2 = t->buckets.home(hash2(h1));
+    bfsNode nodes[MAX_BFS_NODES];
+    while (true) {
+        for (int b : {b1, b2}) {
+            int s = findInBucket(t, b, EMPTY);
+            if (s >= 0) {
+                t->keys[b*SLOTS + s].store(key, memory_order_relaxed);
+                return true;
+            }
+        }
+        int end = findPath(t, b1, b2, nodes);
+        if (end < 0) return false;
+        movePath(t, nodes, end, locking);
+    }
+}
+
+// replace t with a table that has (at least) twice as many buckets, unless someone else already replaced t.
+// noPath means an insert found no cuckoo path in t, so t must grow even if it is not very full.
+template <class CapacityPolicy>
+void AlgorithmCuckoo<CapacityPolicy>::expand(const int tid, table * t, const bool noPath) {
+    // we got here with a (possibly stale) size estimate, so check that the accurate size agrees before locking everything
+    if (current.load(memory_order_relaxed) != t || !(noPath || isExpandNeededAccurate(t))) return;
+    for (int s = 0; s < CUCKOO_NUM_STRIPES; ++s) lock(s);
+    if (current.load(memory_order_relaxed) == t && (noPath || isExpandNeededAccurate(t))) {
+        int numBuckets = t->numBuckets;
+        table * newT = nullptr;
+        bool placedAll = false;
+        while (!placedAll) {
+            // in the (unlikely) event that the keys don't fit, try again with even more buckets
+            delete newT;
+            numBuckets = CapacityPolicy::roundUp(2 * numBuckets);
+            newT = new table(numBuckets);
+            placedAll = true;
+            for (int64_t i = 0; i < (int64_t) t->numBuckets * SLOTS && placedAll; ++i) {
+                int key = t->keys[i].load(memory_order_relaxed);
+                if (key != EMPTY) placedAll = place(newT, key, false);
+            }
+        }
+        current.store(newT, memory_order_release);
+        retired.push_back(t);
+        ++numExpansions;
+    }
+    for (int s = CUCKOO_NUM_STRIPES - 1; s >= 0; --s) unlock(s);
+}
+
+// semantics: try to insert key. return true if successful (if key doesn't already exist), and false otherwise
+template <class CapacityPolicy>
+bool AlgorithmCuckoo<CapacityPolicy>::insertIfAbsent(const int tid, const int & key) {
+    if (contains(tid, key)) return false;
+    uint32_t h1 = murmur3(key);
+    uint32_t h2 = hash2(h1);
+    bfsNode nodes[MAX_BFS_NODES];
+    while (true) {
+        table * t = current.load(memory_order_acquire);
+        if (isExpandNeeded(t)) {
+            expand(tid, t, false);
+            t = current.load(memory_order_acquire);
+        }
+        int b1 = t->buckets.home(h1);
+        int b2 = t->buckets.home(h2);
+        if (!lockBuckets(t, b1, b2)) continue; // t was replaced
+        if (findInBucket(t, b1, key) >= 0 || findInBucket(t, b2, key) >= 0) {
+            unlockBuckets(b1, b2);
+            return false;
+        }
+        for (int b : {b1, b2}) {
+            int s = findInBucket(t, b, EMPTY);
+            if (s >= 0) {
+                t->keys[b*SLOTS + s].store(key, memory_order_relaxed);
+                unlockBuckets(b1, b2);
+                approxInserts->inc(tid);
+                return true;
+            }
+        }
+        unlockBuckets(b1, b2);
+
+        // both buckets are full: move keys along a cuckoo path to free a slot in one of them, and try again
+        int end = findPath(t, b1, b2, nodes);
+        if (end < 0) {
+            expand(tid, t, true);
+        } else {
+            movePath(t, nodes, end, true);
+        }
+    }
+}
+
+// semantics: try to erase key. return true if successful, and false otherwise
+template <class CapacityPolicy>
+bool AlgorithmCuckoo<CapacityPolicy>::erase(const int tid, const int & key) {
+    if (!contains(tid, key)) return false;
+    uint32_t h1 = murmur3(key);
+    uint32_t h2 = hash2(h1);
+    while (true) {
+        table * t = current.load(memory_order_acquire);
+        int b1 = t->buckets.home(h1);
+        int b2 = t->buckets.home(h2);
+        if (!lockBuckets(t, b1, b2)) continue; // t was replaced
+        for (int b : {b1, b2}) {
+            int s = findInBucket(t, b, key);
+            if (s >= 0) {
+                t->keys[b*SLOTS + s].store(EMPTY, memory_order_relaxed);
+                unlockBuckets(b1, b2);
+                approxDeletes->inc(tid);
+                return true;
+            }
+        }
+        unlockBuckets(b1, b2);
+        return false;
+    }
+}
+
+// semantics: return true if key is in the set, and false otherwise. takes no locks, and reads at most two buckets.
+template <class CapacityPolicy>
+bool AlgorithmCuckoo<CapacityPolicy>::contains(const int tid, const int & key) {
+    uint32_t h1 = murmur3(key);
+    uint32_t h2 = hash2(h1);
+    while (true) {
+        table * t = current.load(memory_order_acquire);
+        int b1 = t->buckets.home(h1);
+        int b2 = t->buckets.home(h2);
+        uint32_t v1 = readBegin(stripeOf(b1));
+        uint32_t v2 = readBegin(stripeOf(b2));
+        bool found = findInBucket(t, b1, key) >= 0 || findInBucket(t, b2, key) >= 0;
+        atomic_thread_fence(memory_order_acquire); // keep the key reads before the version re-reads
+        if (versions[stripeOf(b1)].load(memory_order_relaxed) == v1
+                && versions[stripeOf(b2)].load(memory_order_relaxed) == v2
+                && current.load(memory_order_relaxed) == t) {
+            return found;
+        }
+    }
+}
+
+// semantics: return the sum of all KEYS in the set
+template <class CapacityPolicy>
+int64_t AlgorithmCuckoo<CapacityPolicy>::getSumOfKeys() {
+    table * t = current;
+    int64_t total = 0;
+    for (int64_t i = 0; i < (int64_t) t->numBuckets * SLOTS; ++i) {
+        total += t->keys[i].load(memory_order_relaxed);
+    }
+    return total;
+}
+
+// print any debugging details you want at the end of a trial in this function
+template <class CapacityPolicy>
+void AlgorithmCuckoo<CapacityPolicy>::printDebuggingDetails() {
+    table * t = current;
+    PRINT(t->numBuckets);
+    PRINT(numExpansions);
+    cout<<"load factor="<<((approxInserts->getAccurate() - approxDeletes->getAccurate()) / (double) ((int64_t) t->numBuckets * SLOTS))<<endl;
+}
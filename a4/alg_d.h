@@ -1,70 +1,128 @@
 #pragma once
 #include "util.h"
+#include "chunked_migration.h"
 #include <atomic>
 #include <cmath>
+// debugprinting.h (in the record manager) defines TRACE, so keep the TRACE that benchmark_debug passes with -D
+#pragma push_macro("TRACE")
+#undef TRACE
+#include "../a5/recordmgr/record_manager.h"
+#pragma pop_macro("TRACE")
 using namespace std;
 
+/**
+ * Lock-free linear probing set with cooperative, non-blocking resizing (growing and shrinking).
+ *
+ * Slot layout: the low 30 bits hold a key, and two flag bits track its state.
+ *   DELETED_MASK   key was erased. the slot keeps the key, so it stays the ONLY slot
+ *                  for that key in this table (a later insert of the key revives it).
+ *   MARKED_MASK    slot is frozen because this table is being migrated to a new table.
+ * With these definitions, the largest key we allow in the table is KEY_MASK, and the smallest is 1.
+ *
+ * Resizing: the new table points to the old table's array, which is split into chunks (chunked_migration.h).
+ * Migrating an old slot freezes it (sets MARKED_MASK), copies a live key into the new table,
+ * and then marks the old slot DELETED_MASK to record that the copy is done. Any thread can
+ * migrate any slot, and doing it twice is harmless, because a key has one slot per table:
+ * a second copy finds that slot (live or deleted) and does nothing. So:
+ *  - operations never wait for the migration: before working on key k in the new table,
+ *    they read through to k's slot in the old table and migrate just that slot if needed,
+ *  - threads help by claiming chunks, and once every chunk has been claimed, they steal
+ *    (re-migrate) chunks whose claimers haven't finished (e.g., were descheduled).
+ * A table is only replaced after its own migration is finished (which any thread can finish alone).
+ * A new table is sized for the keys that are live in the old table once inserts stop claiming slots
+ * in it, plus one insert per operation that was in flight then (replaceTable), so every copy fits.
+ *
+ * Reclamation: when a table t is replaced, nobody can reach t's old table any more, except threads
+ * that were already working on t. So it is retired to the (DEBRA) record manager, which frees it once
+ * every thread has finished the operation it was in. So, apart from retired tables that are waiting
+ * to be freed, only the current table and its old table are allocated.
+ */
+template <class CapacityPolicy = ModuloCapacity, class HashPolicy = Murmur3Hash>
 class AlgorithmD {
 private:
     enum {
         MARKED_MASK = (int) 0x80000000,     // most significant bit of a 32-bit key
-        TOMBSTONE = (int) 0x7FFFFFFF,       // largest value that doesn't use bit MARKED_MASK
+        DELETED_MASK = (int) 0x40000000,
+        KEY_MASK = (int) 0x3FFFFFFF,
         EMPTY = (int) 0
-    }; // with these definitions, the largest "real" key we allow in the table is 0x7FFFFFFE, and the smallest is 1 !!
+    };
 
-    struct table {
+    struct table : MigratingTable {
         char padding0[PADDING_BYTES];
         // data types
         atomic<int> * data;
-        atomic<int> * old;
+        atomic<int> * old;              // oldTable->data
+        table * oldTable;
         int capacity;
-        int oldCapacity;
+        CapacityPolicy slots;
+        CapacityPolicy oldSlots;
         // Approximate total values with inserts and deletes
         counter * approxInserts;
         counter * approxDeletes;
-        atomic<int> chunksClaimed;
-        atomic<int> chunksDone;
+        counter * approxUsed;           // slots that are no longer EMPTY (live or deleted keys)
         char padding1[PADDING_BYTES];
-        // constructor
-        table(int numThreads, int _capacity) : old(nullptr), oldCapacity(0), chunksClaimed(0), chunksDone(0),
-        capacity(_capacity)
-         {
-            data = new atomic<int>[capacity];
+        // the record manager default constructs records, and then we construct them in place (placement new)
+        table() : data(nullptr), old(nullptr), oldTable(nullptr),
+                  approxInserts(nullptr), approxDeletes(nullptr), approxUsed(nullptr) {}
+        table(int numThreads, int _capacity, table * oldT = nullptr)
+        : MigratingTable(oldT ? oldT->capacity : 0, _capacity / 2), capacity(_capacity) {
+            data = new atomic<int>[capacity] {};
+            oldTable = oldT;
+            slots = CapacityPolicy(capacity);
+            if (oldT) oldSlots = oldT->slots;
+            old = oldT ? oldT->data : nullptr;
             approxInserts = new counter(numThreads);
             approxDeletes = new counter(numThreads);
+            approxUsed = new counter(numThreads);
         }
 
-        // Not sure if any good
-        table(int numThreads, table * oldT): old(oldT->data), oldCapacity(oldT->capacity), chunksClaimed(0), chunksDone(0)
-        {
-            // Calculate new capacity
-            double numInsertedValues = oldT->approxInserts->getAccurate() - oldT->approxDeletes->getAccurate();
-
-            if (numInsertedValues <= 0.0) { numInsertedValues = 1.0; }
-
-            capacity = ceil(4 * numInsertedValues / CHUNK_SIZE) * CHUNK_SIZE;
-
-            data = new atomic<int>[capacity];
-            approxInserts = new counter(numThreads);
-            approxDeletes = new counter(numThreads);
-        } 
-
         // destructor
         ~table(){
-            // The next table may control data...
+            // old belongs to oldTable, which is retired separately
             if (data != nullptr){ delete [] data; }
-            if (old != nullptr){ delete [] old; }
             delete approxInserts;
             delete approxDeletes;
+            delete approxUsed;
         }
     };
-    
-    static const int CHUNK_SIZE = 4096;
-    bool expandAsNeeded(const int tid, table * t, int i);
-    void helpExpansion(const int tid, table * t);
-    void startExpansion(const int tid, table * t);
-    void migrate(const int tid, table * t, int myChunk);
-    
+
+    static const int CHUNK_SIZE = MigratingTable::CHUNK_SIZE;
+    static const int MIN_CAPACITY = CHUNK_SIZE;
+    static const int64_t SIZE_STALENESS_NS = 1000000; // how stale a size estimate can be when deciding to shrink
+    // a table grows (or is rehashed to purge deleted keys) when more than half its slots are used,
+    // shrinks when fewer than 1/16 of its slots hold live keys, and is resized to 4 slots per live key.
+    static int capacityFor(int64_t liveKeys) {
+        return CapacityPolicy::roundUp(max((int64_t) MIN_CAPACITY, (int64_t) ceil(4.0 * max(liveKeys, (int64_t) 1) / CHUNK_SIZE) * CHUNK_SIZE));
+    }
+    // the most keys that inserts can still add to a table that is being replaced (one per operation or batch lane in flight)
+    int64_t inFlightInserts() {
+        return (int64_t) numThreads * BATCH_INFLIGHT;
+    }
+    static int64_t countLive(table * t);
+
+    bool growAsNeeded(const int tid, table * t, int probes);
+    void shrinkAsNeeded(const int tid, table * t);
+    void startResize(const int tid, table * t);
+    void helpMigration(const int tid, table * t);
+    void finishMigration(const int tid, table * t);
+    bool migrateSlot(const int tid, table * t, int index);
+    void migrateKey(const int tid, table * t, int key);
+    bool copyKey(const int tid, table * t, int key);
+    table * newTable(const int tid, int capacity, table * oldT);
+    // the operations, for a key whose hash is h. the caller must hold a tablemgr guard.
+    bool insertHashed(const int tid, const int key, const uint32_t h);
+    bool eraseHashed(const int tid, const int key, const uint32_t h);
+    bool containsHashed(const int tid, const int key, const uint32_t h);
+    // one probe of an operation on key at slot index of tab, which is its probes'th slot (for batches):
+    // STEP_DONE once the operation is resolved (and result is set), STEP_NEXT if it must continue at the
+    // next slot, or STEP_SLOW if it must be redone by the operation above (to resize, or to move to a new table)
+    enum stepResult { STEP_DONE, STEP_NEXT, STEP_SLOW };
+    stepResult insertStep(const int tid, table * tab, const int key, const int index, const int probes, bool & result);
+    stepResult eraseStep(const int tid, table * tab, const int key, const int index, const int probes, bool & result);
+    stepResult containsStep(const int tid, table * tab, const int key, const int index, const int probes, bool & result);
+    template <class Step, class Op>
+    void runBatch(const int tid, const int * keys, const int n, bool * out, Step step, Op op);
+
     char padding0[PADDING_BYTES];
     int numThreads;
     int initCapacity;
@@ -72,180 +130,484 @@ private:
     char padding1[PADDING_BYTES];
     atomic<table *> currentTable;
     char padding2[PADDING_BYTES];
+    simple_record_manager<table> tablemgr;
+    char padding3[PADDING_BYTES];
+    atomic<int> numResizes;
+    char padding4[PADDING_BYTES];
 public:
+    static constexpr int MAX_KEY = KEY_MASK; // keys must be in [1, MAX_KEY]
+
     AlgorithmD(const int _numThreads, const int _capacity);
     ~AlgorithmD();
-    bool insertIfAbsent(const int tid, const int & key, bool disableExpansion);
+    bool insertIfAbsent(const int tid, const int & key);
     bool erase(const int tid, const int & key);
+    bool contains(const int tid, const int & key);
+    void insertBatch(const int tid, const int * keys, const int n, bool * out);
+    void eraseBatch(const int tid, const int * keys, const int n, bool * out);
+    void containsBatch(const int tid, const int * keys, const int n, bool * out);
     long getSumOfKeys();
-    void printDebuggingDetails(); 
+    void printDebuggingDetails();
 };
 
 /**
  * constructor: initialize the hash table's internals
- * 
+ *
  * @param _numThreads maximum number of threads that will ever use the hash table (i.e., at least tid+1, where tid is the largest thread ID passed to any function of this class)
  * @param _capacity is the INITIAL size of the hash table (maximum number of elements it can contain WITHOUT expansion)
  */
-AlgorithmD::AlgorithmD(const int _numThreads, const int _capacity)
-: numThreads(_numThreads), initCapacity(_capacity) {
-    currentTable = new table(numThreads, initCapacity);
+template <class CapacityPolicy, class HashPolicy>
+AlgorithmD<CapacityPolicy, HashPolicy>::AlgorithmD(const int _numThreads, const int _capacity)
+: numThreads(_numThreads), initCapacity(_capacity), tablemgr(MAX_THREADS), numResizes(0) {
+    currentTable = newTable(0, CapacityPolicy::roundUp(initCapacity), nullptr);
 }
 
 // destructor: clean up any allocated memory, etc.
-AlgorithmD::~AlgorithmD() {
-    delete currentTable;
+template <class CapacityPolicy, class HashPolicy>
+AlgorithmD<CapacityPolicy, HashPolicy>::~AlgorithmD() {
+    // older tables were retired, and are freed by tablemgr's destructor
+    table * t = currentTable;
+    if (t->oldTable != nullptr) tablemgr.deallocate(0, t->oldTable);
+    tablemgr.deallocate(0, t);
 }
 
-bool AlgorithmD::expandAsNeeded(const int tid, table * t, int i) {
-    helpExpansion(tid, t);
+template <class CapacityPolicy, class HashPolicy>
+typename AlgorithmD<CapacityPolicy, HashPolicy>::table * AlgorithmD<CapacityPolicy, HashPolicy>::newTable(const int tid, int capacity, table * oldT) {
+    return new (tablemgr.template allocate<table>(tid)) table(numThreads, capacity, oldT);
+}
 
-    // Expanding based on inserts only because that is getting filled
-    if (t->approxInserts->get() > t->capacity/2 ||
-        (i > 10 && t->approxInserts->getAccurate() > t->capacity/2)){
-            startExpansion(tid, t);
+// start a resize if t is too full (counting deleted keys, since they occupy slots until the next resize),
+// or help the resize that is replacing t
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmD<CapacityPolicy, HashPolicy>::growAsNeeded(const int tid, table * t, int probes) {
+    if (t->replacing || t->approxUsed->get() > t->capacity/2 ||
+        (probes > 10 && t->approxUsed->getAccurate() > t->capacity/2)){
+            startResize(tid, t);
             return true;
         }
     return false;
 }
 
-void AlgorithmD::helpExpansion(const int tid, table * t) {
-    int totalOldChunks = ceil(static_cast<float>(t->oldCapacity) / CHUNK_SIZE);
-    while(t->chunksClaimed < totalOldChunks) {
-        int myChunk = t->chunksClaimed.fetch_add(1);
-        if (myChunk < totalOldChunks){
-            // We got a real chunk and we have to move it
-            migrate(tid, t, myChunk);
-            t->chunksDone.fetch_add(1);
-        }
+template <class CapacityPolicy, class HashPolicy>
+void AlgorithmD<CapacityPolicy, HashPolicy>::shrinkAsNeeded(const int tid, table * t) {
+    if (t->capacity <= MIN_CAPACITY || t->isMigrating()) return; // t's counts are incomplete until its migration is done
+    int64_t live = t->approxInserts->readWithin(SIZE_STALENESS_NS) - t->approxDeletes->readWithin(SIZE_STALENESS_NS);
+    if (live < t->capacity/16 && capacityFor(live + inFlightInserts()) < t->capacity) {
+        startResize(tid, t);
     }
+}
 
-    // busy wait until done ? (this seems like blocking)
-    while (!(t->chunksDone == totalOldChunks)) { } // TODO backoff here
+template <class CapacityPolicy, class HashPolicy>
+void AlgorithmD<CapacityPolicy, HashPolicy>::startResize(const int tid, table * t) {
+    bool replaced = replaceTable(tid, currentTable, tablemgr, t, [&]() {
+        int64_t live = t->approxInserts->getAccurate() - t->approxDeletes->getAccurate();
+        // we got here with approximate (possibly stale) counts, so check that the accurate counts agree
+        bool full = t->approxUsed->getAccurate() > t->capacity/2;
+        bool sparse = t->capacity > MIN_CAPACITY && live < t->capacity/16 && capacityFor(live + inFlightInserts()) < t->capacity;
+        return full || sparse;
+    }, [&]() {
+        // t->replacing is set, so the migration copies at most the keys that are live in t now, plus the in-flight inserts
+        return newTable(tid, capacityFor(countLive(t) + inFlightInserts()), t);
+    }, [&](table * newT, int index) { return migrateSlot(tid, newT, index); });
+    if (replaced) numResizes.fetch_add(1);
 }
 
-void AlgorithmD::startExpansion(const int tid, table * t) {
-    if (currentTable == t){
-        table * newT = new table(numThreads, t);
-        // Attempt to insert or else delete
-        if (!currentTable.compare_exchange_strong(t, newT)) { delete newT; }
+// the number of live keys in t (exact if nobody is changing t)
+template <class CapacityPolicy, class HashPolicy>
+int64_t AlgorithmD<CapacityPolicy, HashPolicy>::countLive(table * t) {
+    int64_t live = 0;
+    for (int i = 0; i < t->capacity; ++i){
+        int found = t->data[i];
+        if ((found & KEY_MASK) != EMPTY && !(found & DELETED_MASK)) ++live;
     }
-    helpExpansion(tid, currentTable);
+    return live;
+}
+
+// claim and migrate one chunk of t's old table (if any are left to claim)
+template <class CapacityPolicy, class HashPolicy>
+void AlgorithmD<CapacityPolicy, HashPolicy>::helpMigration(const int tid, table * t) {
+    t->helpMigration([&](int index) { return migrateSlot(tid, t, index); });
 }
 
-void AlgorithmD::migrate(const int tid, table * t, int myChunk) {
-    int start = myChunk * CHUNK_SIZE;
-    for (int idx = start; idx < start + CHUNK_SIZE; ++idx){
+// migrate every chunk of t's old table that isn't finished, including chunks claimed by other threads
+template <class CapacityPolicy, class HashPolicy>
+void AlgorithmD<CapacityPolicy, HashPolicy>::finishMigration(const int tid, table * t) {
+    t->finishMigration([&](int index) { return migrateSlot(tid, t, index); });
+}
+
+// freeze slot index of t's old table, and copy its key into t if it is live. idempotent.
+// returns false if the key didn't fit in t (then the slot is left to be migrated again).
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmD<CapacityPolicy, HashPolicy>::migrateSlot(const int tid, table * t, int index) {
+    int found = t->old[index];
+    while (!(found & MARKED_MASK)) {
         // Mark key before copying it
-        int currentKey = t->old[idx];
-        while (!t->old[idx].compare_exchange_strong(currentKey, currentKey | MARKED_MASK)) {
-            /* try again */ 
-            // Should not be marked because this is our chunk to migrate
-        }
-        // Now copy it
-        insertIfAbsent(currentKey, currentKey, true);
+        if (t->old[index].compare_exchange_strong(found, found | MARKED_MASK)) found |= MARKED_MASK;
     }
+    if ((found & KEY_MASK) == EMPTY || (found & DELETED_MASK)) return true; // nothing (left) to copy
 
-    // Indicate that we are done migrating
-    t->chunksDone++;
+    if (!copyKey(tid, t, found & KEY_MASK)) return false;
+    // record that the copy is done, so nobody copies it again (if this CAS fails, someone else did it)
+    t->old[index].compare_exchange_strong(found, found | DELETED_MASK);
+    return true;
+}
+
+// make sure that, if key is in t's old table, it has been migrated (read-through for operations on key in t)
+template <class CapacityPolicy, class HashPolicy>
+void AlgorithmD<CapacityPolicy, HashPolicy>::migrateKey(const int tid, table * t, int key) {
+    uint32_t h = HashPolicy::hash(key);
+    int index = t->oldSlots.home(h);
+    for (int i = 0; i < t->oldCapacity; ++i, index = t->oldSlots.next(index)){
+        int found = t->old[index];
+        while (found == EMPTY) {
+            // freeze the end of key's probe sequence, so key can't be inserted into the old table behind our back
+            if (t->old[index].compare_exchange_strong(found, found | MARKED_MASK)) return;
+            // someone inserted here: look again
+        }
+        if ((found & KEY_MASK) == key){
+            migrateSlot(tid, t, index);
+            return;
+        } else if ((found & KEY_MASK) == EMPTY){
+            return; // already frozen
+        }
+    }
+}
 
+// insert key into t, unless t already has a slot for key (live or deleted).
+// returns false if t is full (which the room reserved for the migration rules out)
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmD<CapacityPolicy, HashPolicy>::copyKey(const int tid, table * t, int key) {
+    uint32_t h = HashPolicy::hash(key);
+    int index = t->slots.home(h);
+    for (int i = 0; i < t->capacity; ++i, index = t->slots.next(index)){
+        int found = t->data[index];
+        while ((found & KEY_MASK) == EMPTY && !(found & MARKED_MASK)) {
+            if (t->data[index].compare_exchange_strong(found, key)) {
+                t->approxInserts->inc(tid);
+                t->approxUsed->inc(tid);
+                return true;
+            }
+        }
+        if ((found & KEY_MASK) == key || (found & KEY_MASK) == EMPTY) return true; // already copied (or t was migrated after we were delayed)
+    }
+    return false;
 }
 
 // semantics: try to insert key. return true if successful (if key doesn't already exist), and false otherwise
-bool AlgorithmD::insertIfAbsent(const int tid, const int & key, bool disableExpansion = false) {
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmD<CapacityPolicy, HashPolicy>::insertIfAbsent(const int tid, const int & key) {
+    auto guard = tablemgr.getGuard(tid); // tables we reach can't be freed until guard goes out of scope
+    return insertHashed(tid, key, HashPolicy::hash(key));
+}
+
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmD<CapacityPolicy, HashPolicy>::insertHashed(const int tid, const int key, const uint32_t h) {
+retry:
     table * tab = currentTable;
-    int32_t h = murmur3(key);
+    if (tab->isMigrating()) {
+        helpMigration(tid, tab);
+        migrateKey(tid, tab, key);
+    }
 
-    for(int i=0; i < tab->capacity; ++i){
-        if (!disableExpansion && expandAsNeeded(tid, tab, i)) {
-            return insertIfAbsent(tid, key, disableExpansion);
+    int index = tab->slots.home(h);
+    for(int i=0; i < tab->capacity; ++i, index = tab->slots.next(index)){
+        if (i == 0 || i > 10) {
+            if (growAsNeeded(tid, tab, i)) goto retry;
         }
 
         // lookup data
-        // using the indexing method that allows faster migration
-        //int index = floor(h / INT32_MAX * tab->capacity);
-        int index = (h+i) % tab->capacity;
         int found = tab->data[index];
-
-        if (found & MARKED_MASK) {
-            // Restart to help in new table
-            return insertIfAbsent(tid, key, disableExpansion);
-        }
-        else if (found == key){
-            return false; // already here
-        } else if (found == EMPTY){
-            // Attempt insert
-            if(tab->data[index].compare_exchange_strong(found, key)){
-                // CAS success
-                tab->approxInserts->inc(tid); // record we inserted;
-                return true;
-            } else {
-                // CAS failed. found now contains the found value
-                if (found & MARKED_MASK) {
-                    // Marked for expansion, try to insert
-                    return insertIfAbsent(tid, key, disableExpansion);
-                } else if (found == key){
-                    return false;
+        while (true) {
+            if (found & MARKED_MASK) {
+                // Restart to help in new table
+                goto retry;
+            } else if ((found & KEY_MASK) == key) {
+                if (!(found & DELETED_MASK)) return false; // already here
+                // revive our deleted slot
+                if (tab->data[index].compare_exchange_strong(found, key)) {
+                    tab->approxInserts->inc(tid);
+                    return true;
+                }
+            } else if (found == EMPTY) {
+                if (!tab->claimForInsert()) {
+                    // the rest of tab's room is for the keys it is migrating: finish that (never waits), then retry
+                    finishMigration(tid, tab);
+                    goto retry;
+                }
+                // Attempt insert
+                if (tab->data[index].compare_exchange_strong(found, key)) {
+                    tab->approxInserts->inc(tid); // record we inserted;
+                    tab->approxUsed->inc(tid);
+                    return true;
                 }
+            } else {
+                break; // another key's slot, so we continue
             }
+            // CAS failed. found now contains the found value
         }
     }
-    
-    return false;
+
+    startResize(tid, tab); // the table is full
+    goto retry;
 }
 
 
 // semantics: try to erase key. return true if successful, and false otherwise
-bool AlgorithmD::erase(const int tid, const int & key) {
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmD<CapacityPolicy, HashPolicy>::erase(const int tid, const int & key) {
+    auto guard = tablemgr.getGuard(tid);
+    return eraseHashed(tid, key, HashPolicy::hash(key));
+}
+
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmD<CapacityPolicy, HashPolicy>::eraseHashed(const int tid, const int key, const uint32_t h) {
+retry:
     table * tab = currentTable;
-    int32_t h = murmur3(key);
+    if (tab->isMigrating()) {
+        helpMigration(tid, tab);
+        migrateKey(tid, tab, key); // keys that have not been migrated yet are not visible in tab
+    }
 
-    for(int i=0; i < tab->capacity; ++i){
-        // int index = floor(h / INT32_MAX * tab->capacity);
-        int index = (h+i) % tab->capacity;
+    int index = tab->slots.home(h);
+    for(int i=0; i < tab->capacity; ++i, index = tab->slots.next(index)){
         int found = tab->data[index];
-
-        if (found == key) {
-            // Atempt to delete
-            if (tab->data[index].compare_exchange_strong(found, TOMBSTONE)){
-                return true;
-            } else if (found == key | MARKED_MASK){
-                // restart in the new table
-                return erase(tid, key);
-            } else {
-                // This must now be a tombstone
+        while (true) {
+            if (found & MARKED_MASK) {
+                // this table is being migrated: restart in the new table
+                goto retry;
+            } else if ((found & KEY_MASK) == key) {
+                if (found & DELETED_MASK) return false;
+                // Atempt to delete
+                if (tab->data[index].compare_exchange_strong(found, found | DELETED_MASK)) {
+                    tab->approxDeletes->inc(tid);
+                    shrinkAsNeeded(tid, tab);
+                    return true;
+                }
+            } else if (found == EMPTY) {
                 return false;
+            } else {
+                break; // another key's slot, so we continue
             }
+        }
+    }
+
+    return false;
+}
+
+// semantics: return true if key is in the set, and false otherwise. lock-free, and never writes to the table.
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmD<CapacityPolicy, HashPolicy>::contains(const int tid, const int & key) {
+    auto guard = tablemgr.getGuard(tid);
+    return containsHashed(tid, key, HashPolicy::hash(key));
+}
+
+// a lookup never migrates anything: if tab is migrating, a key that has no slot in tab yet is read from tab's old table
+template <class CapacityPolicy, class HashPolicy>
+bool AlgorithmD<CapacityPolicy, HashPolicy>::containsHashed(const int tid, const int key, const uint32_t h) {
+retry:
+    table * tab = currentTable;
+    bool oldSlotFinal = false; // key's slot in the old table is migrated (or gone), so tab has the last word on key
+scan:
+    int index = tab->slots.home(h);
+    for (int i = 0; i < tab->capacity; ++i, index = tab->slots.next(index)){
+        int found = tab->data[index];
+        if (found & MARKED_MASK) {
+            if ((found & KEY_MASK) == key || (found & KEY_MASK) == EMPTY) goto retry; // tab has been replaced
+        } else if ((found & KEY_MASK) == key) {
+            return !(found & DELETED_MASK);
         } else if (found == EMPTY) {
+            break;
+        }
+    }
+    if (oldSlotFinal || !tab->isMigrating()) return false;
+
+    // key has no slot in tab (yet), so if it is anywhere, it is in the old table
+    index = tab->oldSlots.home(h);
+    for (int i = 0; i < tab->oldCapacity; ++i, index = tab->oldSlots.next(index)){
+        int found = tab->old[index];
+        if ((found & KEY_MASK) == key) {
+            if ((found & (MARKED_MASK | DELETED_MASK)) == (MARKED_MASK | DELETED_MASK)) {
+                // either key was copied into tab since we looked, or it was erased before the migration
+                oldSlotFinal = true;
+                goto scan;
+            }
+            return !(found & DELETED_MASK); // frozen but not copied yet, or not migrated yet
+        } else if ((found & KEY_MASK) == EMPTY) {
             return false;
-        } 
-        // tombstone or a different key so we continue
+        }
+    }
+    return false;
+}
+
+template <class CapacityPolicy, class HashPolicy>
+typename AlgorithmD<CapacityPolicy, HashPolicy>::stepResult AlgorithmD<CapacityPolicy, HashPolicy>::insertStep(const int tid, table * tab, const int key, const int index, const int probes, bool & result) {
+    // insertHashed checks whether to grow (or help replace tab) at these probes
+    if ((probes == 0 && (tab->replacing || tab->approxUsed->get() > tab->capacity/2)) || probes > 10) return STEP_SLOW;
+    int found = tab->data[index];
+    while (true) {
+        if (found & MARKED_MASK) {
+            return STEP_SLOW;
+        } else if ((found & KEY_MASK) == key) {
+            if (!(found & DELETED_MASK)) {
+                result = false;
+                return STEP_DONE;
+            }
+            if (tab->data[index].compare_exchange_strong(found, key)) {
+                tab->approxInserts->inc(tid);
+                result = true;
+                return STEP_DONE;
+            }
+        } else if (found == EMPTY) {
+            if (tab->data[index].compare_exchange_strong(found, key)) {
+                tab->approxInserts->inc(tid);
+                tab->approxUsed->inc(tid);
+                result = true;
+                return STEP_DONE;
+            }
+        } else {
+            return STEP_NEXT;
+        }
+    }
+}
 
+template <class CapacityPolicy, class HashPolicy>
+typename AlgorithmD<CapacityPolicy, HashPolicy>::stepResult AlgorithmD<CapacityPolicy, HashPolicy>::eraseStep(const int tid, table * tab, const int key, const int index, const int probes, bool & result) {
+    int found = tab->data[index];
+    while (true) {
+        if (found & MARKED_MASK) {
+            return STEP_SLOW;
+        } else if ((found & KEY_MASK) == key) {
+            if (found & DELETED_MASK) {
+                result = false;
+                return STEP_DONE;
+            }
+            if (tab->data[index].compare_exchange_strong(found, found | DELETED_MASK)) {
+                tab->approxDeletes->inc(tid);
+                shrinkAsNeeded(tid, tab);
+                result = true;
+                return STEP_DONE;
+            }
+        } else if (found == EMPTY) {
+            result = false;
+            return STEP_DONE;
+        } else {
+            return STEP_NEXT;
+        }
+    }
+}
 
+template <class CapacityPolicy, class HashPolicy>
+typename AlgorithmD<CapacityPolicy, HashPolicy>::stepResult AlgorithmD<CapacityPolicy, HashPolicy>::containsStep(const int tid, table * tab, const int key, const int index, const int probes, bool & result) {
+    int found = tab->data[index];
+    if (found & MARKED_MASK) {
+        if ((found & KEY_MASK) == key || (found & KEY_MASK) == EMPTY) return STEP_SLOW; // tab has been replaced
+    } else if ((found & KEY_MASK) == key) {
+        result = !(found & DELETED_MASK);
+        return STEP_DONE;
+    } else if (found == EMPTY) {
+        result = false;
+        return STEP_DONE;
     }
+    return STEP_NEXT;
+}
 
-    return false;
+/**
+ * Batched operations (asynchronous memory access chaining, as in AlgorithmC): up to BATCH_INFLIGHT keys
+ * are in flight, each in its own lane that remembers the table it is probing and the key's current slot.
+ * We prefetch a lane's slot when it starts (or moves to) that slot, and come back to it only after stepping
+ * every other lane, so the misses along all of the lanes' probe sequences overlap one another.
+ *
+ * The steps only handle the common case: a table that is not migrating, and no resize. A key whose table is
+ * migrating, or whose step returns STEP_SLOW, is done by the (unbatched) operation instead, which restarts it
+ * from the current table. out[i] gets the result of the operation on keys[i].
+ */
+template <class CapacityPolicy, class HashPolicy>
+template <class Step, class Op>
+void AlgorithmD<CapacityPolicy, HashPolicy>::runBatch(const int tid, const int * keys, const int n, bool * out, Step step, Op op) {
+    auto guard = tablemgr.getGuard(tid); // one guard for the batch, so the tables that lanes are probing can't be freed under us
+    struct lane {
+        int which;      // index into keys (and out), or -1 if the lane is idle
+        uint32_t h;
+        table * tab;
+        int index;
+        int probes;
+    } lanes[BATCH_INFLIGHT];
+    int next = 0;
+    auto start = [&](lane & l) {
+        while (next < n) {
+            l.which = next++;
+            l.h = HashPolicy::hash(keys[l.which]);
+            l.tab = currentTable;
+            if (!l.tab->isMigrating()) {
+                l.index = l.tab->slots.home(l.h);
+                l.probes = 0;
+                __builtin_prefetch(&l.tab->data[l.index], 1);
+                return;
+            }
+            out[l.which] = (this->*op)(tid, keys[l.which], l.h); // reads through to (and helps migrate) the old table
+        }
+        l.which = -1;
+    };
+
+    int active = 0;
+    for (int i = 0; i < BATCH_INFLIGHT; ++i) {
+        start(lanes[i]);
+        if (lanes[i].which >= 0) ++active;
+    }
+    while (active > 0) {
+        for (int i = 0; i < BATCH_INFLIGHT; ++i) {
+            lane & l = lanes[i];
+            if (l.which < 0) continue;
+            bool result = false;
+            stepResult r = (l.probes == l.tab->capacity) ? STEP_SLOW : (this->*step)(tid, l.tab, keys[l.which], l.index, l.probes, result);
+            if (r == STEP_NEXT) {
+                ++l.probes;
+                l.index = l.tab->slots.next(l.index);
+                __builtin_prefetch(&l.tab->data[l.index], 1);
+                continue;
+            }
+            out[l.which] = (r == STEP_DONE) ? result : (this->*op)(tid, keys[l.which], l.h);
+            start(l);
+            if (l.which < 0) --active;
+        }
+    }
+}
+
+template <class CapacityPolicy, class HashPolicy>
+void AlgorithmD<CapacityPolicy, HashPolicy>::insertBatch(const int tid, const int * keys, const int n, bool * out) {
+    runBatch(tid, keys, n, out, &AlgorithmD::insertStep, &AlgorithmD::insertHashed);
+}
+
+template <class CapacityPolicy, class HashPolicy>
+void AlgorithmD<CapacityPolicy, HashPolicy>::eraseBatch(const int tid, const int * keys, const int n, bool * out) {
+    runBatch(tid, keys, n, out, &AlgorithmD::eraseStep, &AlgorithmD::eraseHashed);
+}
+
+template <class CapacityPolicy, class HashPolicy>
+void AlgorithmD<CapacityPolicy, HashPolicy>::containsBatch(const int tid, const int * keys, const int n, bool * out) {
+    runBatch(tid, keys, n, out, &AlgorithmD::containsStep, &AlgorithmD::containsHashed);
 }
 
 // semantics: return the sum of all KEYS in the set
-int64_t AlgorithmD::getSumOfKeys() {
-    // wait until migration is done
+template <class CapacityPolicy, class HashPolicy>
+int64_t AlgorithmD<CapacityPolicy, HashPolicy>::getSumOfKeys() {
+    auto guard = tablemgr.getGuard(0);
+    // finish any migration that is still in progress
     table * t = currentTable;
-    int totalOldChunks = ceil(static_cast<float>(t->oldCapacity) / CHUNK_SIZE);
-    
-    while(t->chunksClaimed < totalOldChunks || t->chunksDone < totalOldChunks)
-    { /* busy wait */}
+    finishMigration(0, t);
 
     int64_t total = 0;
     for (int i = 0; i < t->capacity; ++i){
-        total += t->data[i];
+        int found = t->data[i];
+        if (!(found & (DELETED_MASK | MARKED_MASK))) total += found;
     }
 
     return total;
 }
 
 // print any debugging details you want at the end of a trial in this function
-void AlgorithmD::printDebuggingDetails() {
+template <class CapacityPolicy, class HashPolicy>
+void AlgorithmD<CapacityPolicy, HashPolicy>::printDebuggingDetails() {
     PRINT(initCapacity);
     PRINT(currentTable.load()->capacity);
+    PRINT(numResizes);
 }
@@ -0,0 +1,406 @@
+#pragma once
+#include "util.h"
+#include "chunked_migration.h"
+#include <atomic>
+#include <cmath>
+// keep our TRACE (see alg_d.h)
+#pragma push_macro("TRACE")
+#undef TRACE
+#include "../a5/recordmgr/record_manager.h"
+#pragma pop_macro("TRACE")
+using namespace std;
+
+/**
+ * Lock-free map from 64-bit keys to 64-bit values, with the same cooperative, chunked
+ * migration as AlgorithmD (see alg_d.h and chunked_migration.h). It only grows (there is no erase).
+ *
+ * No key or value is reserved. Each slot has:
+ *   key    write-once: EMPTY_KEY (0) until the slot is claimed (by CAS) for a key
+ *   cell   { value, state } updated together with a 16-byte CAS (cmpxchg16b, so build with -mcx16).
+ *          state is ABSENT (claimed, but no value yet) or PRESENT, plus flags
+ *          FROZEN (being migrated: the cell never changes again, except to set COPIED) and
+ *          COPIED (its value is in the next table).
+ * The user key 0 can't live in the table (it is EMPTY_KEY), so it has its own cell, zeroCell.
+ *
+ * Updates are a CAS on the cell, conditional on it not being FROZEN, so freezing a cell
+ * (which is how migration starts) and updating it are totally ordered, and no update is lost.
+ * Since a claimed key never leaves its slot, a key has one slot per table, so copying it
+ * twice is harmless (the second copy finds the key's slot already PRESENT and does nothing).
+ * As in AlgorithmD, a new table is sized for every key that can still be claimed in the old table
+ * once it is being replaced, and updates leave room for the migration while it is running.
+ */
+template <class CapacityPolicy = ModuloCapacity>
+class AlgorithmDMap {
+private:
+    enum : uint64_t {
+        ABSENT = 0,
+        PRESENT = 1,
+        FROZEN = 2,
+        COPIED = 4,
+    };
+    static const uint64_t EMPTY_KEY = 0;
+
+    struct alignas(16) cell {
+        uint64_t value;
+        uint64_t state;
+    };
+    static uint64_t loadState(cell * c) { return __atomic_load_n(&c->state, __ATOMIC_ACQUIRE); }
+    static uint64_t loadValue(cell * c) { return __atomic_load_n(&c->value, __ATOMIC_ACQUIRE); }
+    static bool readCell(cell * c, uint64_t & value) {
+        if (!(loadState(c) & PRESENT)) return false;
+        value = loadValue(c); // the value is at least as new as the state we read
+        return true;
+    }
+    // atomically replace { expectedValue, expectedState } with { newValue, newState }
+    static bool casCell(cell * c, uint64_t expectedValue, uint64_t expectedState, uint64_t newValue, uint64_t newState) {
+        unsigned __int128 expected = ((unsigned __int128) expectedState << 64) | expectedValue;
+        unsigned __int128 desired = ((unsigned __int128) newState << 64) | newValue;
+        return __sync_bool_compare_and_swap((unsigned __int128 *) c, expected, desired);
+    }
+    // murmur3's 64-bit finalizer
+    static uint32_t hash64(uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xFF51AFD7ED558CCDULL;
+        key ^= key >> 33;
+        key *= 0xC4CEB9FE1A85EC53ULL;
+        key ^= key >> 33;
+        return (uint32_t) key;
+    }
+
+    struct table : MigratingTable {
+        char padding0[PADDING_BYTES];
+        atomic<uint64_t> * keys;
+        cell * cells;
+        int capacity;
+        CapacityPolicy slots;
+        table * oldTable;
+        counter * approxUsed;           // slots claimed for keys
+        char padding1[PADDING_BYTES];
+        // the record manager default constructs records, and then we construct them in place (placement new)
+        table() : keys(nullptr), cells(nullptr), oldTable(nullptr), approxUsed(nullptr) {}
+        table(int numThreads, int _capacity, table * oldT)
+        : MigratingTable(oldT ? oldT->capacity : 0, _capacity / 2), capacity(_capacity), slots(_capacity), oldTable(oldT) {
+            keys = new atomic<uint64_t>[capacity] {};
+            cells = new cell[capacity] {};
+            approxUsed = new counter(numThreads);
+        }
+        ~table() {
+            // oldTable is retired separately
+            delete [] keys;
+            delete [] cells;
+            delete approxUsed;
+        }
+    };
+
+    static const int CHUNK_SIZE = MigratingTable::CHUNK_SIZE;
+    static const int MIN_CAPACITY = CHUNK_SIZE;
+    // a table grows when more than half its slots are used, to 4 slots per used slot
+    static int capacityFor(int64_t usedSlots) {
+        return CapacityPolicy::roundUp(max((int64_t) MIN_CAPACITY, (int64_t) ceil(4.0 * max(usedSlots, (int64_t) 1) / CHUNK_SIZE) * CHUNK_SIZE));
+    }
+    static int64_t countUsed(table * t);
+
+    // what findSlot does if key has no slot: nothing, claim one for an update (if the migration
+    // leaves room for it, see chunked_migration.h), or claim one for a key being migrated
+    enum claimMode { NO_CLAIM, CLAIM_FOR_UPDATE, CLAIM_FOR_COPY };
+    int findSlot(const int tid, table * t, uint64_t key, uint32_t h, claimMode claim);
+    bool growAsNeeded(const int tid, table * t);
+    void startResize(const int tid, table * t);
+    void helpMigration(const int tid, table * t);
+    void finishMigration(const int tid, table * t);
+    bool migrateSlot(const int tid, table * t, int index);
+    void migrateKey(const int tid, table * t, uint64_t key, uint32_t h);
+    bool copyKey(const int tid, table * t, uint64_t key, uint64_t value);
+    table * newTable(const int tid, int capacity, table * oldT);
+    template <typename CellUpdate>
+    uint64_t updateCell(const int tid, uint64_t key, CellUpdate update);
+
+    char padding0[PADDING_BYTES];
+    int numThreads;
+    int initCapacity;
+    char padding1[PADDING_BYTES];
+    atomic<table *> currentTable;
+    char padding2[PADDING_BYTES];
+    simple_record_manager<table> tablemgr;
+    char padding3[PADDING_BYTES];
+    cell zeroCell;
+    char padding4[PADDING_BYTES];
+    atomic<int> numResizes;
+    char padding5[PADDING_BYTES];
+public:
+    AlgorithmDMap(const int _numThreads, const int _capacity);
+    ~AlgorithmDMap();
+    bool upsert(const int tid, const uint64_t & key, const uint64_t & value); // returns true if key was absent
+    bool get(const int tid, const uint64_t & key, uint64_t & value);         // returns false if key is absent
+    uint64_t fetchAdd(const int tid, const uint64_t & key, const uint64_t & delta); // an absent key is inserted with value delta (and 0 is returned)
+    uint64_t getSumOfValues();
+    int64_t getSize();
+    void printDebuggingDetails();
+};
+
+/**
+ * constructor: initialize the hash table's internals
+ *
+ * @param _numThreads maximum number of threads that will ever use the hash table (i.e., at least tid+1, where tid is the largest thread ID passed to any function of this class)
+ * @param _capacity is the INITIAL size of the hash table (maximum number of elements it can contain WITHOUT expansion)
+ */
+template <class CapacityPolicy>
+AlgorithmDMap<CapacityPolicy>::AlgorithmDMap(const int _numThreads, const int _capacity)
+: numThreads(_numThreads), initCapacity(_capacity), tablemgr(MAX_THREADS), zeroCell {0, ABSENT}, numResizes(0) {
+    currentTable = newTable(0, CapacityPolicy::roundUp(initCapacity), nullptr);
+}
+
+// destructor: clean up any allocated memory, etc.
+template <class CapacityPolicy>
+AlgorithmDMap<CapacityPolicy>::~AlgorithmDMap() {
+    // older tables were retired, and are freed by tablemgr's destructor
+    table * t = currentTable;
+    if (t->oldTable != nullptr) tablemgr.deallocate(0, t->oldTable);
+    tablemgr.deallocate(0, t);
+}
+
+template <class CapacityPolicy>
+typename AlgorithmDMap<CapacityPolicy>::table * AlgorithmDMap<CapacityPolicy>::newTable(const int tid, int capacity, table * oldT) {
+    return new (tablemgr.template allocate<table>(tid)) table(numThreads, capacity, oldT);
+}
+
+// return key's slot in t. if key has no slot, claim an EMPTY one (as claim says).
+// returns -1 if key has no slot (and claim is NO_CLAIM, t is full, or an update must let t's migration finish first).
+template <class CapacityPolicy>
+int AlgorithmDMap<CapacityPolicy>::findSlot(const int tid, table * t, uint64_t key, uint32_t h, claimMode claim) {
+    int index = t->slots.home(h);
+    for (int i = 0; i < t->capacity; ++i, index = t->slots.next(index)) {
+        uint64_t found = t->keys[index];
+        if (found == key) return index;
+        if (found == EMPTY_KEY) {
+            if (claim == NO_CLAIM) return -1;
+            if (claim == CLAIM_FOR_UPDATE && !t->claimForInsert()) return -1;
+            if (t->keys[index].compare_exchange_strong(found, key)) {
+                t->approxUsed->inc(tid);
+                return index;
+            }
+            if (found == key) return index; // someone else claimed it for key
+        }
+    }
+    return -1;
+}
+
+// start a resize if t is too full, or help the resize that is replacing t
+template <class CapacityPolicy>
+bool AlgorithmDMap<CapacityPolicy>::growAsNeeded(const int tid, table * t) {
+    if (t->replacing || t->approxUsed->get() > t->capacity/2) {
+        startResize(tid, t);
+        return true;
+    }
+    return false;
+}
+
+template <class CapacityPolicy>
+void AlgorithmDMap<CapacityPolicy>::startResize(const int tid, table * t) {
+    bool replaced = replaceTable(tid, currentTable, tablemgr, t, [&]() {
+        // we got here with an approximate count, so check that the accurate count agrees
+        return t->approxUsed->getAccurate() > t->capacity/2;
+    }, [&]() {
+        // t->replacing is set, so only the updates in flight (one per thread) can still claim slots in t
+        return newTable(tid, capacityFor(countUsed(t) + numThreads), t);
+    }, [&](table * newT, int index) { return migrateSlot(tid, newT, index); });
+    if (replaced) numResizes.fetch_add(1);
+}
+
+// the number of slots claimed for keys in t (exact if nobody is changing t)
+template <class CapacityPolicy>
+int64_t AlgorithmDMap<CapacityPolicy>::countUsed(table * t) {
+    int64_t used = 0;
+    for (int i = 0; i < t->capacity; ++i){
+        if (t->keys[i] != EMPTY_KEY) ++used;
+    }
+    return used;
+}
+
+// claim and migrate one chunk of t's old table (if any are left to claim)
+template <class CapacityPolicy>
+void AlgorithmDMap<CapacityPolicy>::helpMigration(const int tid, table * t) {
+    t->helpMigration([&](int index) { return migrateSlot(tid, t, index); });
+}
+
+// migrate every chunk of t's old table that isn't finished, including chunks claimed by other threads
+template <class CapacityPolicy>
+void AlgorithmDMap<CapacityPolicy>::finishMigration(const int tid, table * t) {
+    t->finishMigration([&](int index) { return migrateSlot(tid, t, index); });
+}
+
+// freeze cell index of t's old table, and copy its key and value into t if it is PRESENT. idempotent.
+// returns false if the key didn't fit in t (then the cell is left to be migrated again).
+template <class CapacityPolicy>
+bool AlgorithmDMap<CapacityPolicy>::migrateSlot(const int tid, table * t, int index) {
+    table * old = t->oldTable;
+    cell * c = &old->cells[index];
+    uint64_t state, value;
+    while (true) {
+        state = loadState(c);
+        value = loadValue(c);
+        if (state & FROZEN) break;
+        if (casCell(c, value, state, value, state | FROZEN)) {
+            state |= FROZEN;
+            break;
+        }
+    }
+    if (!(state & PRESENT) || (state & COPIED)) return true; // nothing (left) to copy
+
+    if (!copyKey(tid, t, old->keys[index], value)) return false;
+    // record that the copy is done, so nobody copies it again (if this CAS fails, someone else did it)
+    casCell(c, value, state, value, state | COPIED);
+    return true;
+}
+
+// make sure that, if key has a value in t's old table, it has been migrated (read-through for operations on key in t)
+template <class CapacityPolicy>
+void AlgorithmDMap<CapacityPolicy>::migrateKey(const int tid, table * t, uint64_t key, uint32_t h) {
+    table * old = t->oldTable;
+    int index = old->slots.home(h);
+    for (int i = 0; i < old->capacity; ++i, index = old->slots.next(index)){
+        uint64_t found = old->keys[index];
+        if (found == EMPTY_KEY) {
+            // freeze the cell at the end of key's probe sequence, so if key is claimed here later, it can't get a value.
+            // then look again, in case key was claimed (and given a value) before we froze the cell.
+            cell * c = &old->cells[index];
+            uint64_t state;
+            while (!((state = loadState(c)) & FROZEN)) {
+                uint64_t value = loadValue(c);
+                if (casCell(c, value, state, value, state | FROZEN)) break;
+            }
+            found = old->keys[index];
+            if (found == EMPTY_KEY) return;
+        }
+        if (found == key) {
+            migrateSlot(tid, t, index);
+            return;
+        }
+    }
+}
+
+// give key value in t, unless key already has a value in t.
+// returns false if t is full (which the room reserved for the migration rules out)
+template <class CapacityPolicy>
+bool AlgorithmDMap<CapacityPolicy>::copyKey(const int tid, table * t, uint64_t key, uint64_t value) {
+    int index = findSlot(tid, t, key, hash64(key), CLAIM_FOR_COPY);
+    if (index < 0) return false;
+    cell * c = &t->cells[index];
+    uint64_t state;
+    while ((state = loadState(c)) == ABSENT) {
+        if (casCell(c, loadValue(c), ABSENT, value, PRESENT)) return true;
+    }
+    return true; // already copied (and possibly updated since then)
+}
+
+// apply update (which maps { state, value } to a new value) to key's cell. returns the previous value (0 if absent).
+template <class CapacityPolicy>
+template <typename CellUpdate>
+uint64_t AlgorithmDMap<CapacityPolicy>::updateCell(const int tid, uint64_t key, CellUpdate update) {
+    if (key == EMPTY_KEY) {
+        while (true) {
+            uint64_t state = loadState(&zeroCell);
+            uint64_t value = loadValue(&zeroCell);
+            uint64_t oldValue = (state & PRESENT) ? value : 0;
+            if (casCell(&zeroCell, value, state, update(state & PRESENT, oldValue), PRESENT)) return oldValue;
+        }
+    }
+
+    auto guard = tablemgr.getGuard(tid); // tables we reach can't be freed until guard goes out of scope
+    uint32_t h = hash64(key);
+retry:
+    table * tab = currentTable;
+    if (tab->isMigrating()) {
+        helpMigration(tid, tab);
+        migrateKey(tid, tab, key, h);
+    }
+    if (growAsNeeded(tid, tab)) goto retry;
+    int index = findSlot(tid, tab, key, h, CLAIM_FOR_UPDATE);
+    if (index < 0) {
+        if (tab->isMigrating()) {
+            finishMigration(tid, tab); // the rest of tab's room is for the keys it is migrating (this never waits)
+        } else {
+            startResize(tid, tab); // the table is full
+        }
+        goto retry;
+    }
+    cell * c = &tab->cells[index];
+    while (true) {
+        uint64_t state = loadState(c);
+        uint64_t value = loadValue(c);
+        if (state & FROZEN) goto retry; // tab is being migrated to a newer table
+        uint64_t oldValue = (state & PRESENT) ? value : 0;
+        if (casCell(c, value, state, update(state & PRESENT, oldValue), PRESENT)) return oldValue;
+    }
+}
+
+// semantics: set key's value. return true if key was absent, and false if it was updated
+template <class CapacityPolicy>
+bool AlgorithmDMap<CapacityPolicy>::upsert(const int tid, const uint64_t & key, const uint64_t & value) {
+    bool wasPresent;
+    updateCell(tid, key, [&](bool present, uint64_t oldValue) {
+        wasPresent = present;
+        return value;
+    });
+    return !wasPresent;
+}
+
+// semantics: add delta to key's value (inserting key with value delta if it is absent), and return its previous value
+template <class CapacityPolicy>
+uint64_t AlgorithmDMap<CapacityPolicy>::fetchAdd(const int tid, const uint64_t & key, const uint64_t & delta) {
+    return updateCell(tid, key, [&](bool present, uint64_t oldValue) {
+        return oldValue + delta;
+    });
+}
+
+// semantics: if key is present, store its value in value and return true. otherwise, return false
+template <class CapacityPolicy>
+bool AlgorithmDMap<CapacityPolicy>::get(const int tid, const uint64_t & key, uint64_t & value) {
+    if (key == EMPTY_KEY) return readCell(&zeroCell, value);
+
+    auto guard = tablemgr.getGuard(tid, true);
+    uint32_t h = hash64(key);
+    table * tab = currentTable;
+    if (tab->isMigrating()) migrateKey(tid, tab, key, h);
+    int index = findSlot(tid, tab, key, h, NO_CLAIM);
+    if (index < 0) return false;
+    // if the cell is FROZEN, it holds key's value from when tab was replaced (which happened during this operation)
+    return readCell(&tab->cells[index], value);
+}
+
+// semantics: return the sum of all VALUES in the map (and finish any migration that is still in progress)
+template <class CapacityPolicy>
+uint64_t AlgorithmDMap<CapacityPolicy>::getSumOfValues() {
+    auto guard = tablemgr.getGuard(0);
+    table * t = currentTable;
+    finishMigration(0, t);
+
+    uint64_t total = (zeroCell.state & PRESENT) ? zeroCell.value : 0;
+    for (int i = 0; i < t->capacity; ++i){
+        if (t->cells[i].state & PRESENT) total += t->cells[i].value;
+    }
+    return total;
+}
+
+// semantics: return the number of keys in the map
+template <class CapacityPolicy>
+int64_t AlgorithmDMap<CapacityPolicy>::getSize() {
+    auto guard = tablemgr.getGuard(0);
+    table * t = currentTable;
+    finishMigration(0, t);
+
+    int64_t size = (zeroCell.state & PRESENT) ? 1 : 0;
+    for (int i = 0; i < t->capacity; ++i){
+        if (t->cells[i].state & PRESENT) ++size;
+    }
+    return size;
+}
+
+// print any debugging details you want at the end of a trial in this function
+template <class CapacityPolicy>
+void AlgorithmDMap<CapacityPolicy>::printDebuggingDetails() {
+    PRINT(initCapacity);
+    PRINT(currentTable.load()->capacity);
+    PRINT(numResizes);
+    PRINT(getSize());
+}
@@ -0,0 +1,274 @@
+#pragma once
+#include "util.h"
+#include <atomic>
+using namespace std;
+
+#ifndef ROBIN_HOOD_MAX_DISPLACEMENT
+#define ROBIN_HOOD_MAX_DISPLACEMENT 128 // no key is ever stored more than this many slots after its home slot
+#endif
+#ifndef ROBIN_HOOD_STRIPE_WIDTH
+#define ROBIN_HOOD_STRIPE_WIDTH 16      // slots guarded by each versioned lock
+#endif
+
+/**
+ * Robin Hood hashing (linear probing where a key being inserted takes the slot of any
+ * key that is closer to its home slot, and shifts the rest of the run right by one),
+ * with backward shift deletion, so there are no tombstones.
+ *
+ * Every slot stores its key's displacement (distance from its home slot), so a search
+ * for key stops as soon as it sees a slot whose displacement is smaller than the number
+ * of slots it has looked at: key would have taken that slot. Displacements are also bounded
+ * by ROBIN_HOOD_MAX_DISPLACEMENT, so the table never wraps around: it has that many extra
+ * slots at the end. There is no expansion, so an insert that would exceed the bound fails:
+ * insertIfAbsent returns false, as if key were already present (these are counted in numFullInserts).
+ *
+ * Synchronization, as in AlgorithmAStriped: each window of ROBIN_HOOD_STRIPE_WIDTH slots has a
+ * versioned lock (odd = locked). Searches take no locks: they read the windows they cross
+ * optimistically, and retry if any of their versions changed. An update first searches, and
+ * returns immediately if there is nothing to do (key present for insert, absent for erase).
+ * Otherwise, it locks windows from its home slot's window upward, as far as its shift reaches.
+ * Every update locks windows in increasing order, so updates can't deadlock.
+ */
+template <class CapacityPolicy = ModuloCapacity>
+class AlgorithmRobinHood {
+private:
+    static_assert(ROBIN_HOOD_MAX_DISPLACEMENT <= 255, "displacements are stored in a uint8_t");
+    static const int MAX_WINDOWS_PER_SEARCH = ROBIN_HOOD_MAX_DISPLACEMENT / ROBIN_HOOD_STRIPE_WIDTH + 2;
+
+    char padding0[PADDING_BYTES];
+    const int numThreads;
+    int capacity;           // number of home slots
+    int totalSlots;         // capacity + ROBIN_HOOD_MAX_DISPLACEMENT + 1
+    int numStripes;
+    CapacityPolicy slots;
+    char padding1[PADDING_BYTES];
+    atomic<int> * keys;
+    atomic<uint8_t> * displacements;
+    atomic<uint32_t> * versions; // one per window
+    char padding2[PADDING_BYTES];
+    atomic<int64_t> numFullInserts; // inserts that failed because of the displacement bound
+    char padding3[PADDING_BYTES];
+
+    // wait until the window is unlocked, and return its version
+    uint32_t readBegin(const int stripe) {
+        uint32_t v;
+        int backoff = 1;
+        while ((v = versions[stripe].load(memory_order_acquire)) & 1) {
+            for (int i=0;i<backoff;++i) _mm_pause();
+            if (backoff < 1024) backoff <<= 1;
+        }
+        return v;
+    }
+    void lock(const int stripe) {
+        while (true) {
+            uint32_t v = readBegin(stripe);
+            if (versions[stripe].compare_exchange_strong(v, v+1)) return;
+        }
+    }
+    void unlock(const int stripe) {
+        versions[stripe].store(versions[stripe].load(memory_order_relaxed) + 1, memory_order_release);
+    }
+
+    enum searchResult { FOUND, ABSENT };
+    searchResult search(const int & key, int home);
+    int insertLocked(const int & key, int home, int & lockedThrough);
+    bool eraseLocked(const int & key, int home, int & lockedThrough);
+
+public:
+    static constexpr int EMPTY = 0;
+
+    AlgorithmRobinHood(const int _numThreads, const int _capacity);
+    ~AlgorithmRobinHood();
+    bool insertIfAbsent(const int tid, const int & key);
+    bool erase(const int tid, const int & key);
+    bool contains(const int tid, const int & key);
+    long getSumOfKeys();
+    void printDebuggingDetails();
+};
+
+/**
+ * constructor: initialize the hash table's internals
+ *
+ * @param _numThreads maximum number of threads that will ever use the hash table (i.e., at least tid+1, where tid is the largest thread ID passed to any function of this class)
+ * @param _capacity is the INITIAL size of the hash table (maximum number of elements it can contain WITHOUT expansion)
+ */
+template <class CapacityPolicy>
+AlgorithmRobinHood<CapacityPolicy>::AlgorithmRobinHood(const int _numThreads, const int _capacity)
+: numThreads(_numThreads), numFullInserts(0) {
+    capacity = CapacityPolicy::roundUp(_capacity);
+    slots = CapacityPolicy(capacity);
+    totalSlots = capacity + ROBIN_HOOD_MAX_DISPLACEMENT + 1;
+    numStripes = (totalSlots + ROBIN_HOOD_STRIPE_WIDTH - 1) / ROBIN_HOOD_STRIPE_WIDTH;
+    keys = new atomic<int>[totalSlots] {};
+    displacements = new atomic<uint8_t>[totalSlots] {};
+    versions = new atomic<uint32_t>[numStripes] {};
+}
+
+// destructor: clean up any allocated memory, etc.
+template <class CapacityPolicy>
+AlgorithmRobinHood<CapacityPolicy>::~AlgorithmRobinHood() {
+    delete[] keys;
+    delete[] displacements;
+    delete[] versions;
+}
+
+// optimistic (lock-free) search for key, starting at its home slot
+template <class CapacityPolicy>
+typename AlgorithmRobinHood<CapacityPolicy>::searchResult AlgorithmRobinHood<CapacityPolicy>::search(const int & key, int home) {
+    int stripes[MAX_WINDOWS_PER_SEARCH];
+    uint32_t stripeVersions[MAX_WINDOWS_PER_SEARCH];
+retry:
+    int numStripesRead = 0;
+    searchResult result = ABSENT;
+    for (int pos = home, d = 0; d <= ROBIN_HOOD_MAX_DISPLACEMENT; ++pos, ++d) {
+        int stripe = pos / ROBIN_HOOD_STRIPE_WIDTH;
+        if (numStripesRead == 0 || stripes[numStripesRead-1] != stripe) {
+            stripes[numStripesRead] = stripe;
+            stripeVersions[numStripesRead++] = readBegin(stripe);
+        }
+        int found = keys[pos].load(memory_order_relaxed);
+        if (found == EMPTY || displacements[pos].load(memory_order_relaxed) < d) break; // key would be here
+        if (found == key) {
+            result = FOUND;
+            break;
+        }
+    }
+    atomic_thread_fence(memory_order_acquire); // keep the key reads before the version re-reads
+    for (int i=0;i<numStripesRead;++i) {
+        if (versions[stripes[i]].load(memory_order_relaxed) != stripeVersions[i]) goto retry;
+    }
+    return result;
+}
+
+// with windows up to lockedThrough locked (extending the range as needed), insert key.
+// returns 1 if inserted, 0 if key was already present, and -1 if the displacement bound would be exceeded.
+template <class CapacityPolicy>
+int AlgorithmRobinHood<CapacityPolicy>::insertLocked(const int & key, int home, int & lockedThrough) {
+    auto lockThrough = [&](int pos) {
+        while (lockedThrough < pos / ROBIN_HOOD_STRIPE_WIDTH) lock(++lockedThrough);
+    };
+
+    // find where key goes: an EMPTY slot, or the first slot whose key is closer to its home than we are
+    int pos = home;
+    int d = 0;
+    for (;; ++pos, ++d) {
+        if (d > ROBIN_HOOD_MAX_DISPLACEMENT) return -1;
+        lockThrough(pos);
+        int found = keys[pos].load(memory_order_relaxed);
+        if (found == key) return 0;
+        if (found == EMPTY) {
+            keys[pos].store(key, memory_order_relaxed);
+            displacements[pos].store(d, memory_order_relaxed);
+            return 1;
+        }
+        if (displacements[pos].load(memory_order_relaxed) < d) break;
+    }
+
+    // shift the run that starts at pos right by one slot (every key in it moves one slot further from home)
+    int end = pos;
+    for (;; ++end) {
+        if (end >= totalSlots) return -1;
+        lockThrough(end);
+        if (keys[end].load(memory_order_relaxed) == EMPTY) break;
+        if (displacements[end].load(memory_order_relaxed) >= ROBIN_HOOD_MAX_DISPLACEMENT) return -1;
+    }
+    for (int i = end; i > pos; --i) {
+        keys[i].store(keys[i-1].load(memory_order_relaxed), memory_order_relaxed);
+        displacements[i].store(displacements[i-1].load(memory_order_relaxed) + 1, memory_order_relaxed);
+    }
+    keys[pos].store(key, memory_order_relaxed);
+    displacements[pos].store(d, memory_order_relaxed);
+    return 1;
+}
+
+// with windows up to lockedThrough locked (extending the range as needed), erase key.
+template <class CapacityPolicy>
+bool AlgorithmRobinHood<CapacityPolicy>::eraseLocked(const int & key, int home, int & lockedThrough) {
+    auto lockThrough = [&](int pos) {
+        while (lockedThrough < pos / ROBIN_HOOD_STRIPE_WIDTH) lock(++lockedThrough);
+    };
+
+    int pos = home;
+    for (int d = 0;; ++pos, ++d) {
+        if (d > ROBIN_HOOD_MAX_DISPLACEMENT) return false;
+        lockThrough(pos);
+        int found = keys[pos].load(memory_order_relaxed);
+        if (found == EMPTY || displacements[pos].load(memory_order_relaxed) < d) return false;
+        if (found == key) break;
+    }
+
+    // backward shift: move the rest of the run (keys that aren't in their home slot) left by one slot
+    int next = pos + 1;
+    for (; next < totalSlots; ++next) {
+        lockThrough(next);
+        if (keys[next].load(memory_order_relaxed) == EMPTY || displacements[next].load(memory_order_relaxed) == 0) break;
+        keys[next-1].store(keys[next].load(memory_order_relaxed), memory_order_relaxed);
+        displacements[next-1].store(displacements[next].load(memory_order_relaxed) - 1, memory_order_relaxed);
+    }
+    keys[next-1].store(EMPTY, memory_order_relaxed);
+    displacements[next-1].store(0, memory_order_relaxed);
+    return true;
+}
+
+// semantics: try to insert key. return true if successful (if key doesn't already exist), and false otherwise
+// (including when key would exceed ROBIN_HOOD_MAX_DISPLACEMENT)
+template <class CapacityPolicy>
+bool AlgorithmRobinHood<CapacityPolicy>::insertIfAbsent(const int tid, const int & key) {
+    int home = slots.home(murmur3(key));
+    if (search(key, home) == FOUND) return false;
+
+    int firstStripe = home / ROBIN_HOOD_STRIPE_WIDTH;
+    int lockedThrough = firstStripe - 1;
+    int result = insertLocked(key, home, lockedThrough);
+    for (int stripe = firstStripe; stripe <= lockedThrough; ++stripe) unlock(stripe);
+    if (result < 0) numFullInserts.fetch_add(1, memory_order_relaxed);
+    return result > 0;
+}
+
+// semantics: try to erase key. return true if successful, and false otherwise
+template <class CapacityPolicy>
+bool AlgorithmRobinHood<CapacityPolicy>::erase(const int tid, const int & key) {
+    int home = slots.home(murmur3(key));
+    if (search(key, home) == ABSENT) return false;
+
+    int firstStripe = home / ROBIN_HOOD_STRIPE_WIDTH;
+    int lockedThrough = firstStripe - 1;
+    bool result = eraseLocked(key, home, lockedThrough);
+    for (int stripe = firstStripe; stripe <= lockedThrough; ++stripe) unlock(stripe);
+    return result;
+}
+
+// semantics: return true if key is in the set, and false otherwise. takes no locks (see search)
+template <class CapacityPolicy>
+bool AlgorithmRobinHood<CapacityPolicy>::contains(const int tid, const int & key) {
+    return search(key, slots.home(murmur3(key))) == FOUND;
+}
+
+// semantics: return the sum of all KEYS in the set
+template <class CapacityPolicy>
+int64_t AlgorithmRobinHood<CapacityPolicy>::getSumOfKeys() {
+    int64_t total = 0;
+    for (int index = 0; index < totalSlots; ++index){
+        total += keys[index];
+    }
+    return total;
+}
+
+// print any debugging details you want at the end of a trial in this function
+template <class CapacityPolicy>
+void AlgorithmRobinHood<CapacityPolicy>::printDebuggingDetails() {
+    int64_t size = 0;
+    int64_t totalDisplacement = 0;
+    int maxDisplacement = 0;
+    for (int index = 0; index < totalSlots; ++index){
+        if (keys[index] == EMPTY) continue;
+        ++size;
+        totalDisplacement += displacements[index];
+        maxDisplacement = max(maxDisplacement, (int) displacements[index]);
+    }
+    PRINT(capacity);
+    cout<<"load factor="<<(size / (double) capacity)<<endl;
+    cout<<"average displacement="<<(size ? totalDisplacement / (double) size : 0)<<endl;
+    PRINT(maxDisplacement);
+    PRINT(numFullInserts);
+}
@@ -0,0 +1,376 @@
+#pragma once
+#include "util.h"
+#include "tombstone_purge.h"
+#include <atomic>
+#include <cstring>
+// debugprinting.h (in the record manager) defines TRACE, so keep the TRACE that benchmark_debug passes with -D
+#pragma push_macro("TRACE")
+#undef TRACE
+#include "../a5/recordmgr/record_manager.h"
+#pragma pop_macro("TRACE")
+using namespace std;
+
+#ifndef SWISS_GROUP_WIDTH
+#ifdef __AVX2__
+#define SWISS_GROUP_WIDTH 32 // control bytes compared per probe (one AVX2 register)
+#else
+#define SWISS_GROUP_WIDTH 16 // control bytes compared per probe (one SSE2 register)
+#endif
+#endif
+
+/**
+ * Same semantics as AlgorithmC (CAS on keys, tombstones purged by migrating into a new table of the
+ * same capacity, no expansion), but probing is done a group of SWISS_GROUP_WIDTH slots at a time,
+ * swiss table style.
+ *
+ * Next to the keys is an array of 1-byte control words: CTRL_EMPTY, or a 7-bit fingerprint of the
+ * key in the slot. A probe loads a whole group of control bytes and compares them to the fingerprint
+ * and to CTRL_EMPTY with one SIMD compare each, so a miss usually touches one line of control bytes
+ * and no keys.
+ *
+ * Keys are still claimed by CAS on the key (EMPTY -> key), exactly as in AlgorithmC, and the control
+ * byte is written AFTER that, so it is only a hint: a slot whose control byte is CTRL_EMPTY may already
+ * hold a key (whose control byte isn't written yet), and we read the key of every such slot. But a slot
+ * whose control byte is a fingerprint definitely holds a key, so it can be skipped unless the fingerprint
+ * matches. A key keeps its slot (and fingerprint) when it is erased, as in AlgorithmC, so a later insert
+ * of the key finds and revives that slot.
+ *
+ * Probing visits the slots of consecutive groups in order, so it is linear probing that starts at the
+ * beginning of the key's first group, and tombstones are purged exactly as in AlgorithmC (tombstone_purge.h).
+ */
+class AlgorithmSwiss {
+private:
+    enum : uint8_t {
+        CTRL_EMPTY = 0x80,      // fingerprints are 0x00-0x7F
+    };
+    enum {
+        MARKED_MASK = PurgeableTable::MARKED_MASK,
+        DELETED_MASK = PurgeableTable::DELETED_MASK,
+        KEY_MASK = PurgeableTable::KEY_MASK,
+        EMPTY = PurgeableTable::EMPTY
+    };
+#if SWISS_GROUP_WIDTH == 32
+    typedef uint32_t groupmask_t;
+    static groupmask_t matchByte(const uint8_t * group, uint8_t b) {
+        __m256i ctrl = _mm256_load_si256((const __m256i *) group);
+        return _mm256_movemask_epi8(_mm256_cmpeq_epi8(ctrl, _mm256_set1_epi8(b)));
+    }
+#else
+    typedef uint16_t groupmask_t;
+    static groupmask_t matchByte(const uint8_t * group, uint8_t b) {
+        __m128i ctrl = _mm_load_si128((const __m128i *) group);
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(b)));
+    }
+#endif
+
+    struct table : PurgeableTable {
+        char padding0[PADDING_BYTES];
+        uint8_t * ctrl;         // aligned to SWISS_GROUP_WIDTH
+        atomic<int> * keys;
+        table * oldTable;
+        char padding1[PADDING_BYTES];
+        // the record manager default constructs records, and then we construct them in place (placement new)
+        table() : ctrl(nullptr), keys(nullptr), oldTable(nullptr) {}
+        table(int numThreads, int capacity, int insertLimit, table * oldT)
+        : PurgeableTable(numThreads, capacity, oldT ? capacity : 0, insertLimit), oldTable(oldT) {
+            ctrl = (uint8_t *) aligned_alloc(SWISS_GROUP_WIDTH, capacity);
+            memset(ctrl, CTRL_EMPTY, capacity);
+            keys = new atomic<int>[capacity] {};
+        }
+        ~table() {
+            if (ctrl != nullptr) free(ctrl);
+            if (keys != nullptr) delete [] keys;
+        }
+    };
+
+    char padding0[PADDING_BYTES];
+    const int numThreads;
+    int capacity;
+    int numGroups;
+    char padding1[PADDING_BYTES];
+    atomic<table *> currentTable;
+    char padding2[PADDING_BYTES];
+    simple_record_manager<table> tablemgr;
+    char padding3[PADDING_BYTES];
+    atomic<int> numPurges;
+    char padding4[PADDING_BYTES];
+
+    static uint8_t fingerprintOf(uint32_t h) { return h & 0x7F; }
+    int firstGroupOf(uint32_t h) { return (h >> 7) % numGroups; }
+
+    // result of searching tab for key: FOUND if slot is key's slot (live, deleted or frozen), ABSENT if slot is
+    // the EMPTY (or frozen EMPTY) slot where key's probe sequence ends, and FULL if there is neither.
+    // found gets the contents of slot (or EMPTY if FULL).
+    enum findResult { FOUND, ABSENT, FULL };
+    findResult find(table * tab, const int & key, uint32_t h, int & slot, int & found);
+    void setCtrl(table * tab, int slot, uint8_t c) {
+        __atomic_store_n(&tab->ctrl[slot], c, __ATOMIC_RELEASE);
+    }
+
+    table * newTable(const int tid, int insertLimit, table * oldT);
+    bool purgeAsNeeded(const int tid, table * t);
+    bool startPurge(const int tid, table * t);
+    void helpMigration(const int tid, table * t);
+    void finishMigration(const int tid, table * t);
+    bool migrateSlot(const int tid, table * t, int index);
+    void migrateKey(const int tid, table * t, int key, uint32_t h);
+    bool copyKey(const int tid, table * t, int key);
+
+public:
+    static constexpr int MAX_KEY = KEY_MASK; // keys must be in [1, MAX_KEY]
+
+    AlgorithmSwiss(const int _numThreads, const int _capacity);
+    ~AlgorithmSwiss();
+    bool insertIfAbsent(const int tid, const int & key);
+    bool erase(const int tid, const int & key);
+    bool contains(const int tid, const int & key);
+    long getSumOfKeys();
+    void printDebuggingDetails();
+};
+
+/**
+ * constructor: initialize the hash table's internals
+ *
+ * @param _numThreads maximum number of threads that will ever use the hash table (i.e., at least tid+1, where tid is the largest thread ID passed to any function of this class)
+ * @param _capacity is the INITIAL size of the hash table (rounded up to a multiple of SWISS_GROUP_WIDTH)
+ */
+AlgorithmSwiss::AlgorithmSwiss(const int _numThreads, const int _capacity)
+: numThreads(_numThreads), capacity(max(1, (_capacity + SWISS_GROUP_WIDTH - 1) / SWISS_GROUP_WIDTH) * SWISS_GROUP_WIDTH),
+  numGroups(capacity / SWISS_GROUP_WIDTH), tablemgr(MAX_THREADS), numPurges(0) {
+    currentTable = newTable(0, capacity, nullptr);
+}
+
+// destructor: clean up any allocated memory, etc.
+AlgorithmSwiss::~AlgorithmSwiss() {
+    // older tables were retired, and are freed by tablemgr's destructor
+    table * t = currentTable;
+    if (t->oldTable != nullptr) tablemgr.deallocate(0, t->oldTable);
+    tablemgr.deallocate(0, t);
+}
+
+AlgorithmSwiss::table * AlgorithmSwiss::newTable(const int tid, int insertLimit, table * oldT) {
+    return new (tablemgr.allocate<table>(tid)) table(numThreads, capacity, insertLimit, oldT);
+}
+
+// start purging t if it has too many tombstones, or help the purge that is replacing t.
+// returns true if the caller must restart its operation in the current table
+bool AlgorithmSwiss::purgeAsNeeded(const int tid, table * t) {
+    if (t->replacing || t->isPurgeNeeded(0)) return startPurge(tid, t);
+    return false;
+}
+
+// replace t with a new table that holds only t's live keys, as AlgorithmC::startPurge does
+bool AlgorithmSwiss::startPurge(const int tid, table * t) {
+    bool purged = replaceTable(tid, currentTable, tablemgr, t, [&]() {
+        return t->shouldPurge(capacity);
+    }, [&]() {
+        // t->replacing is set, so the migration copies at most the keys that are live in t now, plus one insert per thread
+        return newTable(tid, PurgeableTable::insertLimitFor(capacity, PurgeableTable::countLive(t->keys, capacity) + numThreads), t);
+    }, [&](table * newT, int index) { return migrateSlot(tid, newT, index); });
+    if (purged) numPurges.fetch_add(1);
+    return purged || currentTable != t;
+}
+
+// claim and migrate one chunk of t's old table (if any are left to claim)
+void AlgorithmSwiss::helpMigration(const int tid, table * t) {
+    t->helpMigration([&](int index) { return migrateSlot(tid, t, index); });
+}
+
+// migrate every chunk of t's old table that isn't finished, including chunks claimed by other threads
+void AlgorithmSwiss::finishMigration(const int tid, table * t) {
+    t->finishMigration([&](int index) { return migrateSlot(tid, t, index); });
+}
+
+// freeze slot index of t's old table, and copy its key into t if it is live. idempotent.
+bool AlgorithmSwiss::migrateSlot(const int tid, table * t, int index) {
+    return PurgeableTable::migrateSlot(t->oldTable->keys, index, [&](int key) { return copyKey(tid, t, key); });
+}
+
+// make sure that, if key is in t's old table, it has been migrated (read-through for operations on key in t)
+void AlgorithmSwiss::migrateKey(const int tid, table * t, int key, uint32_t h) {
+    while (true) {
+        int slot, found;
+        auto result = find(t->oldTable, key, h, slot, found);
+        if (result == FOUND) {
+            migrateSlot(tid, t, slot);
+            return;
+        } else if (result == FULL || (found & MARKED_MASK)) {
+            return; // nothing to migrate, and no EMPTY slot to freeze (or it is already frozen)
+        }
+        // freeze the end of key's probe sequence, so key can't be inserted into the old table behind our back
+        if (t->oldTable->keys[slot].compare_exchange_strong(found, found | MARKED_MASK)) return;
+        // someone inserted here: look again
+    }
+}
+
+// insert key into t, unless t already has a slot for key (live or deleted).
+// returns false if t is full (which the room reserved for the migration rules out)
+bool AlgorithmSwiss::copyKey(const int tid, table * t, int key) {
+    uint32_t h = murmur3(key);
+    while (true) {
+        int slot, found;
+        auto result = find(t, key, h, slot, found);
+        if (result == FULL) return false;
+        if (result == FOUND || (found & MARKED_MASK)) return true; // already copied (or t was purged after we were delayed)
+        if (t->keys[slot].compare_exchange_strong(found, key)) {
+            setCtrl(t, slot, fingerprintOf(h));
+            return true;
+        }
+    }
+}
+
+AlgorithmSwiss::findResult AlgorithmSwiss::find(table * tab, const int & key, uint32_t h, int & slot, int & found) {
+    uint8_t fingerprint = fingerprintOf(h);
+    int g = firstGroupOf(h);
+    for (int probes = 0; probes < numGroups; ++probes) {
+        int base = g * SWISS_GROUP_WIDTH;
+        __builtin_prefetch(&tab->keys[base]); // overlap the miss on the keys with the control byte compares
+        // slots that may hold key: matching fingerprints, and EMPTY control bytes (whose keys may not be published yet)
+        groupmask_t candidates = matchByte(&tab->ctrl[base], fingerprint) | matchByte(&tab->ctrl[base], CTRL_EMPTY);
+        while (candidates) {
+            int i = base + __builtin_ctz(candidates);
+            candidates &= candidates - 1;
+            found = tab->keys[i];
+            if ((found & KEY_MASK) == key) {
+                slot = i;
+                return FOUND;
+            } else if ((found & KEY_MASK) == EMPTY) {
+                slot = i;
+                return ABSENT;
+            }
+        }
+        g = (g + 1 == numGroups) ? 0 : g + 1;
+    }
+    slot = -1;
+    found = EMPTY;
+    return FULL;
+}
+
+// semantics: try to insert key. return true if successful (if key doesn't already exist), and false otherwise
+// (including when the table has no EMPTY slot for key)
+bool AlgorithmSwiss::insertIfAbsent(const int tid, const int & key) {
+    auto guard = tablemgr.getGuard(tid); // tables we reach can't be freed until guard goes out of scope
+    uint32_t h = murmur3(key);
+retry:
+    table * tab = currentTable;
+    if (tab->isMigrating()) {
+        helpMigration(tid, tab);
+        migrateKey(tid, tab, key, h);
+    }
+    if (purgeAsNeeded(tid, tab)) goto retry;
+
+    while (true) {
+        int slot, found;
+        auto result = find(tab, key, h, slot, found);
+        if (result == FULL) {
+            if (currentTable != tab) goto retry; // tab was replaced while we probed it
+            return false; // no EMPTY slot for key (there aren't enough tombstones to purge yet)
+        } else if (found & MARKED_MASK) {
+            // tab is being purged: restart in the new table
+            goto retry;
+        } else if (result == FOUND) {
+            if (!(found & DELETED_MASK)) return false; // already here
+            // revive our deleted slot (its control byte is still our fingerprint, or not written yet)
+            if (tab->keys[slot].compare_exchange_strong(found, key)) {
+                tab->approxRevives->inc(tid);
+                return true;
+            }
+        } else {
+            if (!tab->claimForInsert()) {
+                // the rest of tab's room is for the keys it is migrating: finish that (never waits), then retry
+                finishMigration(tid, tab);
+                goto retry;
+            }
+            if (tab->keys[slot].compare_exchange_strong(found, key)) {
+                setCtrl(tab, slot, fingerprintOf(h));
+                return true;
+            }
+        }
+        // CAS failed: search again (a slot that was EMPTY is no longer EMPTY, so we get further)
+    }
+}
+
+// semantics: try to erase key. return true if successful, and false otherwise
+bool AlgorithmSwiss::erase(const int tid, const int & key) {
+    auto guard = tablemgr.getGuard(tid);
+    uint32_t h = murmur3(key);
+retry:
+    table * tab = currentTable;
+    if (tab->isMigrating()) {
+        helpMigration(tid, tab);
+        migrateKey(tid, tab, key, h); // keys that have not been migrated yet are not visible in tab
+    }
+
+    while (true) {
+        int slot, found;
+        auto result = find(tab, key, h, slot, found);
+        if (found & MARKED_MASK) {
+            // tab is being purged: restart in the new table
+            goto retry;
+        } else if (result != FOUND || (found & DELETED_MASK)) {
+            return false;
+        }
+        if (tab->keys[slot].compare_exchange_strong(found, found | DELETED_MASK)) {
+            tab->approxDeletes->inc(tid);
+            return true;
+        }
+    }
+}
+
+// semantics: return true if key is in the set, and false otherwise. lock-free, and never writes to the table.
+// a lookup never migrates anything: if the table is being purged, a key that has no slot in the new table yet
+// is read from the old table (as in AlgorithmC)
+bool AlgorithmSwiss::contains(const int tid, const int & key) {
+    auto guard = tablemgr.getGuard(tid);
+    uint32_t h = murmur3(key);
+retry:
+    table * tab = currentTable;
+    bool oldSlotFinal = false; // key's slot in the old table is migrated (or gone), so tab has the last word on key
+scan:
+    int slot, found;
+    auto result = find(tab, key, h, slot, found);
+    if (found & MARKED_MASK) {
+        goto retry; // tab has been replaced
+    } else if (result == FOUND) {
+        return !(found & DELETED_MASK);
+    } else if (oldSlotFinal || !tab->isMigrating()) {
+        return false;
+    }
+
+    // key has no slot in tab (yet), so if it is anywhere, it is in the old table
+    if (find(tab->oldTable, key, h, slot, found) != FOUND) return false;
+    if ((found & (MARKED_MASK | DELETED_MASK)) == (MARKED_MASK | DELETED_MASK)) {
+        // either key was copied into tab since we looked, or it was erased before the purge
+        oldSlotFinal = true;
+        goto scan;
+    }
+    return !(found & DELETED_MASK); // frozen but not copied yet, or not migrated yet
+}
+
+// semantics: return the sum of all KEYS in the set
+int64_t AlgorithmSwiss::getSumOfKeys() {
+    auto guard = tablemgr.getGuard(0);
+    // finish any purge that is still in progress
+    table * t = currentTable;
+    finishMigration(0, t);
+
+    int64_t total = 0;
+    for (int index = 0; index < capacity; ++index){
+        int found = t->keys[index];
+        if (!(found & (DELETED_MASK | MARKED_MASK))) total += found;
+    }
+    return total;
+}
+
+// print any debugging details you want at the end of a trial in this function
+void AlgorithmSwiss::printDebuggingDetails() {
+    PRINT(SWISS_GROUP_WIDTH);
+    PRINT(numGroups);
+    PRINT(numPurges);
+    table * t = currentTable;
+    int64_t tombstones = 0;
+    for (int index = 0; index < capacity; ++index){
+        if (t->keys[index] & DELETED_MASK) ++tombstones;
+    }
+    PRINT(tombstones);
+}
@@ -12,9 +12,14 @@
 
 #include "util.h"
 #include "alg_a.h"
+#include "alg_a_striped.h"
 #include "alg_b.h"
 #include "alg_c.h"
 #include "alg_d.h"
+#include "alg_swiss.h"
+#include "alg_robin_hood.h"
+#include "alg_d_map.h"
+#include "alg_cuckoo.h"
 
 using namespace std;
 
@@ -28,13 +33,14 @@ struct globals_t {
     volatile char padding2[PADDING_BYTES];
     volatile bool done;
     volatile char padding3[PADDING_BYTES];
-    volatile bool start;        // used for a custom barrier implementation (should threads start yet?)
+    ParkingWord start;          // used for a custom barrier implementation (should threads start yet?)
     volatile char padding4[PADDING_BYTES];
-    atomic_int running;         // used for a custom barrier implementation (how many threads are waiting?)
+    ParkingWord running;        // used for a custom barrier implementation (how many threads are waiting?)
     volatile char padding5[PADDING_BYTES];
     DataStructureType * ds;
     debugCounter numTotalOps;   // already has padding built in at the beginning and end
     debugCounter keyChecksum;
+    debugCounter numLookupHits; // "uses" the results of contains, so contains isn't optimized out
     int millisToRun;
     int totalThreads;
     int keyRangeSize;
@@ -47,8 +53,6 @@ struct globals_t {
         }
         elapsedMillis = 0;
         done = false;
-        start = false;
-        running = 0;
         ds = _ds;
         millisToRun = _millisToRun;
         totalThreads = _totalThreads;
@@ -60,6 +64,158 @@ struct globals_t {
     }
 } __attribute__((aligned(PADDING_BYTES)));
 
+int percentGets = 0;          // map workload only: percentage of operations that are gets (the rest are fetchAdds)
+double insertPercent = 50;    // set workload only: percentage of operations that are inserts
+double deletePercent = 50;    // set workload only: percentage of operations that are erases (the rest are contains)
+int batchSize = 1;            // set workload only: keys per insertBatch/eraseBatch/containsBatch call (1 means single-key operations)
+
+#ifndef MAX_BATCH_SIZE
+#define MAX_BATCH_SIZE 1024
+#endif
+
+// which algorithms have contains
+template <class DataStructureType> struct supportsContains { static const bool value = false; };
+template <class CapacityPolicy, class HashPolicy> struct supportsContains<AlgorithmA<CapacityPolicy, HashPolicy>> { static const bool value = true; };
+template <class CapacityPolicy, class HashPolicy> struct supportsContains<AlgorithmB<CapacityPolicy, HashPolicy>> { static const bool value = true; };
+template <class CapacityPolicy, class HashPolicy> struct supportsContains<AlgorithmC<CapacityPolicy, HashPolicy>> { static const bool value = true; };
+template <class CapacityPolicy, class HashPolicy> struct supportsContains<AlgorithmD<CapacityPolicy, HashPolicy>> { static const bool value = true; };
+template <class CapacityPolicy> struct supportsContains<AlgorithmCuckoo<CapacityPolicy>> { static const bool value = true; };
+template <class CapacityPolicy> struct supportsContains<AlgorithmRobinHood<CapacityPolicy>> { static const bool value = true; };
+template <> struct supportsContains<AlgorithmSwiss> { static const bool value = true; };
+
+// which algorithms have insertBatch/eraseBatch/containsBatch
+template <class DataStructureType> struct supportsBatch { static const bool value = false; };
+template <class CapacityPolicy, class HashPolicy> struct supportsBatch<AlgorithmC<CapacityPolicy, HashPolicy>> { static const bool value = true; };
+template <class CapacityPolicy, class HashPolicy> struct supportsBatch<AlgorithmD<CapacityPolicy, HashPolicy>> { static const bool value = true; };
+
+// the batched set workload: batchSize random keys in [1, keyRangeSize], each of which is inserted, erased
+// or looked up (according to insertPercent and deletePercent). the inserts go in one insertBatch call,
+// then the erases in one eraseBatch call, and then the lookups in one containsBatch call.
+template <class DataStructureType>
+int doRandomBatch(globals_t<DataStructureType> * g, const int tid) {
+    int insertKeys[MAX_BATCH_SIZE] {};
+    int eraseKeys[MAX_BATCH_SIZE] {};
+    int lookupKeys[MAX_BATCH_SIZE] {};
+    bool results[MAX_BATCH_SIZE];
+    int numInserts = 0;
+    int numErases = 0;
+    int numLookups = 0;
+    for (int i=0;i<batchSize;++i) {
+        double operationType = g->rngs[tid].nextNatural() / (double) numeric_limits<unsigned int>::max() * 100;
+        int key = 1 + (g->rngs[tid].nextNatural() % g->keyRangeSize);
+        if (operationType < insertPercent) insertKeys[numInserts++] = key;
+        else if (operationType < insertPercent + deletePercent) eraseKeys[numErases++] = key;
+        else lookupKeys[numLookups++] = key;
+    }
+
+    g->ds->insertBatch(tid, insertKeys, numInserts, results);
+    for (int i=0;i<numInserts;++i) {
+        if (results[i]) g->keyChecksum.add(tid, insertKeys[i]);
+    }
+    g->ds->eraseBatch(tid, eraseKeys, numErases, results);
+    for (int i=0;i<numErases;++i) {
+        if (results[i]) g->keyChecksum.add(tid, -eraseKeys[i]);
+    }
+    if (numLookups) {
+        g->ds->containsBatch(tid, lookupKeys, numLookups, results);
+        int hits = 0;
+        for (int i=0;i<numLookups;++i) hits += results[i];
+        g->numLookupHits.add(tid, hits);
+    }
+    return batchSize;
+}
+
+// the set workload: insert, erase or look up (according to insertPercent and deletePercent) a random key in [1, keyRangeSize].
+// returns the number of operations performed.
+template <class DataStructureType>
+int doRandomOperation(globals_t<DataStructureType> * g, const int tid) {
+    if constexpr (supportsBatch<DataStructureType>::value) {
+        if (batchSize > 1) return doRandomBatch(g, tid);
+    }
+
+    // generate a random double in [0, 100] to decide: insert, erase or contains?
+    double operationType = g->rngs[tid].nextNatural() / (double) numeric_limits<unsigned int>::max() * 100;
+
+    // generate random key
+    int key = 1 + (g->rngs[tid].nextNatural() % g->keyRangeSize);
+
+    if (operationType < insertPercent) {
+        auto result = g->ds->insertIfAbsent(tid, key);
+        if (result) g->keyChecksum.add(tid, key);
+    } else if (operationType < insertPercent + deletePercent) {
+        auto result = g->ds->erase(tid, key);
+        if (result) g->keyChecksum.add(tid, -key);
+    } else {
+        if constexpr (supportsContains<DataStructureType>::value) {
+            if (g->ds->contains(tid, key)) g->numLookupHits.inc(tid);
+        }
+    }
+    return 1;
+}
+
+// fill the set to the size it would have in the steady state of the workload (a fraction
+// insertPercent / (insertPercent + deletePercent) of the key range), so lookups don't just
+// probe an empty table. the main thread does this (as thread 0) before the timer starts.
+template <class DataStructureType>
+void prefill(globals_t<DataStructureType> * g) {
+    if constexpr (!supportsContains<DataStructureType>::value) {
+        cout<<"ERROR: this algorithm has no contains, so insertPercent + deletePercent must be 100"<<endl;
+        exit(1);
+    }
+    double totalUpdatePercent = insertPercent + deletePercent;
+    int64_t expectedSize = g->keyRangeSize * ((totalUpdatePercent < 1e-6) ? 0.5 : insertPercent / totalUpdatePercent);
+    int64_t size = 0;
+    // random keys, so (like coupon collecting) we need more attempts than keys. give up eventually (e.g., if the table is too small)
+    for (int64_t attempts = 0; size < expectedSize && attempts < 4 * (int64_t) g->keyRangeSize; ++attempts) {
+        int key = 1 + (g->rngs[0].nextNatural() % g->keyRangeSize);
+        if (g->ds->insertIfAbsent(0, key)) {
+            g->keyChecksum.add(0, key);
+            ++size;
+        }
+    }
+    cout<<"prefilling completed to size "<<size<<" (expected size "<<expectedSize<<")"<<endl;
+}
+
+// the map workload starts empty (and ignores insertPercent and deletePercent)
+template <class CapacityPolicy>
+void prefill(globals_t<AlgorithmDMap<CapacityPolicy>> * g) {}
+
+// the map workload: update in place (fetchAdd a small delta) or get a random key.
+// there are keyRangeSize keys, spread over all 64 bits (including key 0).
+// keyChecksum is the sum of all deltas, so it should equal the sum of all values.
+template <class CapacityPolicy>
+int doRandomOperation(globals_t<AlgorithmDMap<CapacityPolicy>> * g, const int tid) {
+    bool isGet = (int) (g->rngs[tid].nextNatural() % 100) < percentGets;
+    uint64_t key = (g->rngs[tid].nextNatural() % g->keyRangeSize) * 0x9E3779B97F4A7C15ULL;
+    if (isGet) {
+        uint64_t value;
+        g->ds->get(tid, key, value);
+    } else {
+        uint64_t delta = 1 + g->rngs[tid].nextNatural() % 8;
+        g->ds->fetchAdd(tid, key, delta);
+        g->keyChecksum.add(tid, delta);
+    }
+    return 1;
+}
+
+template <class DataStructureType>
+bool validate(globals_t<DataStructureType> * g) {
+    auto dsSumOfKeys = g->ds->getSumOfKeys();
+    auto threadsSumOfKeys = g->keyChecksum.getTotal();
+    cout<<"Validation: sum of keys according to the data structure = "<<dsSumOfKeys<<" and sum of keys according to the threads = "<<threadsSumOfKeys<<".";
+    cout<<((threadsSumOfKeys == dsSumOfKeys) ? " OK." : " FAILED.")<<endl;
+    return threadsSumOfKeys == dsSumOfKeys;
+}
+
+template <class CapacityPolicy>
+bool validate(globals_t<AlgorithmDMap<CapacityPolicy>> * g) {
+    uint64_t dsSumOfValues = g->ds->getSumOfValues();
+    uint64_t threadsSumOfDeltas = g->keyChecksum.getTotal();
+    cout<<"Validation: sum of values according to the data structure = "<<dsSumOfValues<<" and sum of deltas according to the threads = "<<threadsSumOfDeltas<<".";
+    cout<<((threadsSumOfDeltas == dsSumOfValues) ? " OK." : " FAILED.")<<endl;
+    return threadsSumOfDeltas == dsSumOfValues;
+}
+
 void printUpdatedThroughput(auto g, int64_t elapsedNow) {
     auto opsNow = g->numTotalOps.getTotal();
     cout<<elapsedNow <<"ms: "<<opsNow<<" total_ops"<<endl;
@@ -72,6 +228,8 @@ void runExperiment(int keyRangeSize, int tableSize, int millisToRun, int totalTh
     auto dataStructure = new DataStructureType(totalThreads, tableSize);
     auto g = new globals_t<DataStructureType>(millisToRun, totalThreads, keyRangeSize, tableSize, dataStructure);
     
+    if (insertPercent + deletePercent < 100) prefill(g);
+    
     /**
      * 
      * RUN EXPERIMENT
@@ -86,7 +244,7 @@ void runExperiment(int keyRangeSize, int tableSize, int millisToRun, int totalTh
 
                 // BARRIER WAIT
                 g->running.fetch_add(1);
-                while (!g->start) { TRACE TPRINT("waiting to start"); } // wait to start
+                g->start.waitUntil([](int v) { return v; }); // wait to start (spin, then park, so oversubscribed runs don't burn the cores of threads that are still being created)
                 
                 for (int cnt=0; !g->done; ++cnt) {
                     if ((cnt % OPS_BETWEEN_TIME_CHECKS) == 0                    // once every X operations
@@ -97,24 +255,7 @@ void runExperiment(int keyRangeSize, int tableSize, int millisToRun, int totalTh
 
                     VERBOSE if (cnt&&((cnt % 1000000) == 0)) TPRINT("op# "<<cnt);
                     
-                    // flip a coin to decide: insert or erase?
-                    // generate a random double in [0, 1]
-                    double operationType = g->rngs[tid].nextNatural() / (double) numeric_limits<unsigned int>::max();
-                    //cout<<"operationType="<<operationType<<endl;
-                    
-                    // generate random key
-                    int key = 1 + (g->rngs[tid].nextNatural() % g->keyRangeSize);
-                    
-                    // insert or delete this key
-                    if (operationType < 0.5) {
-                        auto result = g->ds->insertIfAbsent(tid, key);
-                        if (result) g->keyChecksum.add(tid, key);
-                    } else {
-                        auto result = g->ds->erase(tid, key);
-                        if (result) g->keyChecksum.add(tid, -key);
-                    }
-                    
-                    g->numTotalOps.inc(tid);
+                    g->numTotalOps.add(tid, doRandomOperation(g, tid));
                 }
                 
                 g->running.fetch_add(-1);
@@ -122,23 +263,20 @@ void runExperiment(int keyRangeSize, int tableSize, int millisToRun, int totalTh
         });
     }
 
-    while (g->running < g->totalThreads) {
-        TRACE printf("main thread: waiting for threads to START running=%d\n", g->running.load());
-    } // wait for all threads to be ready
+    g->running.waitUntil([&](int v) { return v >= g->totalThreads; }); // wait for all threads to be ready
     
     printf("main thread: starting timer...\n");
     g->timer.startTimer();
-    __asm__ __volatile__ ("" ::: "memory"); // prevent compiler from reordering "start = true;" before the timer start; this is mostly paranoia, since start is volatile, and nothing should be reordered around volatile reads/writes (by the *compiler*)
+    __asm__ __volatile__ ("" ::: "memory"); // prevent compiler from reordering the release of the barrier before the timer start (mostly paranoia)
     
-    g->start = true; // release all threads from the barrier, so they can work
-    __sync_synchronize(); // flush store buffer so other threads can see the write to g->start immediately (so they start working ASAP)
+    g->start.store(1); // release all threads from the barrier, so they can work (seq_cst store, and it wakes any parked threads)
     
     
     // wait for all threads to stop working,
     // and print throughput update every 1s
     
     int64_t lastTime = 0;
-    while (g->running > 0) {
+    while (g->running.load() > 0) {
         // sleep for 0.1s
         timespec time_to_sleep;
         time_to_sleep.tv_sec = 0;
@@ -177,13 +315,10 @@ void runExperiment(int keyRangeSize, int tableSize, int millisToRun, int totalTh
     g->ds->printDebuggingDetails();
     
     auto numTotalOps = g->numTotalOps.getTotal();
-    auto dsSumOfKeys = g->ds->getSumOfKeys();
-    auto threadsSumOfKeys = g->keyChecksum.getTotal();
-    cout<<"Validation: sum of keys according to the data structure = "<<dsSumOfKeys<<" and sum of keys according to the threads = "<<threadsSumOfKeys<<".";
-    cout<<((threadsSumOfKeys == dsSumOfKeys) ? " OK." : " FAILED.")<<endl;
+    bool valid = validate(g);
     cout<<endl;
 
-    if (threadsSumOfKeys != dsSumOfKeys) {
+    if (!valid) {
         cout<<"ERROR: validation failed!"<<endl;
         exit(-1);
     }
@@ -194,6 +329,7 @@ void runExperiment(int keyRangeSize, int tableSize, int millisToRun, int totalTh
     }
     cout<<endl;
     cout<<"total completed ops   : "<<numTotalOps<<endl;
+    cout<<"successful lookups    : "<<g->numLookupHits.getTotal()<<endl;
     cout<<"throughput            : "<<(long long) (numTotalOps * 1000. / g->elapsedMillis)<<endl;
     cout<<"elapsed milliseconds  : "<<g->elapsedMillis<<endl;
     cout<<endl;
@@ -201,15 +337,63 @@ void runExperiment(int keyRangeSize, int tableSize, int millisToRun, int totalTh
     delete g;
 }
 
+// run DataStructureType with the capacity policy named by capacityPolicy (see util.h)
+template <template <class> class DataStructureType>
+void runExperimentWithCapacityPolicy(const char * capacityPolicy, int keyRangeSize, int tableSize, int millisToRun, int totalThreads) {
+    if (!strcmp(capacityPolicy, ModuloCapacity::name())) {
+        runExperiment<DataStructureType<ModuloCapacity>>(keyRangeSize, tableSize, millisToRun, totalThreads);
+    } else if (!strcmp(capacityPolicy, PowerOfTwoCapacity::name())) {
+        runExperiment<DataStructureType<PowerOfTwoCapacity>>(keyRangeSize, tableSize, millisToRun, totalThreads);
+    } else if (!strcmp(capacityPolicy, FastRangeCapacity::name())) {
+        runExperiment<DataStructureType<FastRangeCapacity>>(keyRangeSize, tableSize, millisToRun, totalThreads);
+    } else {
+        cout<<"Bad capacity policy: "<<capacityPolicy<<endl;
+        exit(1);
+    }
+}
+
+// DataStructureType with its hash policy fixed to HashPolicy (so it can be passed to runExperimentWithCapacityPolicy)
+template <template <class, class> class DataStructureType, class HashPolicy>
+struct withHashPolicy {
+    template <class CapacityPolicy>
+    using type = DataStructureType<CapacityPolicy, HashPolicy>;
+};
+
+// run DataStructureType with the hash and capacity policies named by hashPolicy and capacityPolicy (see util.h)
+template <template <class, class> class DataStructureType>
+void runExperimentWithHashPolicy(const char * hashPolicy, const char * capacityPolicy, int keyRangeSize, int tableSize, int millisToRun, int totalThreads) {
+    if (!strcmp(hashPolicy, Murmur3Hash::name())) {
+        runExperimentWithCapacityPolicy<withHashPolicy<DataStructureType, Murmur3Hash>::template type>(capacityPolicy, keyRangeSize, tableSize, millisToRun, totalThreads);
+    } else if (!strcmp(hashPolicy, CRC32CHash::name())) {
+        runExperimentWithCapacityPolicy<withHashPolicy<DataStructureType, CRC32CHash>::template type>(capacityPolicy, keyRangeSize, tableSize, millisToRun, totalThreads);
+    } else if (!strcmp(hashPolicy, MultiplyShiftHash::name())) {
+        runExperimentWithCapacityPolicy<withHashPolicy<DataStructureType, MultiplyShiftHash>::template type>(capacityPolicy, keyRangeSize, tableSize, millisToRun, totalThreads);
+    } else if (!strcmp(hashPolicy, IdentityHash::name())) {
+        runExperimentWithCapacityPolicy<withHashPolicy<DataStructureType, IdentityHash>::template type>(capacityPolicy, keyRangeSize, tableSize, millisToRun, totalThreads);
+    } else {
+        cout<<"Bad hash policy: "<<hashPolicy<<endl;
+        exit(1);
+    }
+}
+
 int main(int argc, char** argv) {
     if (argc == 1) {
         cout<<"USAGE: "<<argv[0]<<" [options]"<<endl;
         cout<<"Options:"<<endl;
-        cout<<"    -a  [string]   [a]lgorithm name in { A, B, C, D }"<<endl;
+        cout<<"    -a  [string]   [a]lgorithm name in { A, AS, B, C, D, S, RH, CK, DM } (AS: A with dense keys and striped versioned locks, S: C with SIMD group probing, RH: Robin Hood with bounded displacement, CK: two-choice cuckoo hashing with striped locks and expansion, DM: D as a 64-bit key/value map, running the fetchAdd/get workload)"<<endl;
         cout<<"    -sT [int]      size of initial hash [T]able"<<endl;
         cout<<"    -m  [int]      [m]illiseconds to run"<<endl;
         cout<<"    -sR [int]      size of the key [R]ange that random keys will be drawn from (i.e., range [1, s])"<<endl;
-        cout<<"    -t  [int]      number of [t]hreads that will perform inserts and deletes"<<endl;
+        cout<<"    -t  [int]      number of [t]hreads that will perform operations"<<endl;
+        cout<<"    -i  [double]   percent of operations that will be [i]nsert [default 50]"<<endl;
+        cout<<"    -d  [double]   percent of operations that will be [d]elete [default 50]"<<endl;
+        cout<<"                   (100 - i - d)% of operations will be contains (A, B, C, D, S, RH and CK only), and then the table is prefilled to its steady state size"<<endl;
+        cout<<"    -os [int]      [o]ver[s]ubscribe: run [int] threads per online logical processor (overrides -t)"<<endl;
+        cout<<"    -spin          never park waiting threads (pure spinning), to compare against spin-then-park"<<endl;
+        cout<<"    -g  [int]      DM only: percentage of operations that are [g]ets (the rest are fetchAdds) [default 0]"<<endl;
+        cout<<"    -b  [int]      C and D only: [b]atch size, i.e., keys per insertBatch/eraseBatch/containsBatch call (at most "<<MAX_BATCH_SIZE<<") [default 1: no batching]"<<endl;
+        cout<<"    -hf [string]   [h]ash [f]unction policy in { murmur3, crc32c, multshift, identity } [default murmur3] (A, B, C and D only)"<<endl;
+        cout<<"    -cp [string]   [c]apacity [p]olicy in { mod, pow2, fastrange } mapping hashes to slots [default mod] (pow2 rounds -sT up; ignored by S)"<<endl;
         cout<<endl;
         cout<<"Example: "<<argv[0]<<" -a D -m 10000 -sT 1000 -sR 1000000 -t 16"<<endl;
         return 1;
@@ -219,7 +403,10 @@ int main(int argc, char** argv) {
     int tableSize = 0;
     int keyRangeSize = 0;
     int totalThreads = 0;
+    int oversubscription = 0;
     char * alg = NULL;
+    const char * capacityPolicy = ModuloCapacity::name();
+    const char * hashPolicy = Murmur3Hash::name();
     
     // read command line args
     for (int i=1;i<argc;++i) {
@@ -233,12 +420,32 @@ int main(int argc, char** argv) {
             millisToRun = atoi(argv[++i]);
         } else if (strcmp(argv[i], "-a") == 0) {
             alg = argv[++i];
+        } else if (strcmp(argv[i], "-os") == 0) {
+            oversubscription = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-spin") == 0) {
+            spinParkEnabled = false;
+        } else if (strcmp(argv[i], "-g") == 0) {
+            percentGets = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-i") == 0) {
+            insertPercent = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0) {
+            deletePercent = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-b") == 0) {
+            batchSize = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-hf") == 0) {
+            hashPolicy = argv[++i];
+        } else if (strcmp(argv[i], "-cp") == 0) {
+            capacityPolicy = argv[++i];
         } else {
             cout<<"bad arguments"<<endl;
             exit(1);
         }
     }
     
+    if (oversubscription > 0) {
+        totalThreads = oversubscription * sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
     // print command and args for debugging
     std::cout<<"Cmd:";
     for (int i=0;i<argc;++i) {
@@ -252,7 +459,14 @@ int main(int argc, char** argv) {
     PRINT(keyRangeSize);
     PRINT(tableSize);
     PRINT(totalThreads);
+    PRINT(spinParkEnabled);
     PRINT(alg);
+    PRINT(capacityPolicy);
+    PRINT(hashPolicy);
+    PRINT(insertPercent);
+    PRINT(deletePercent);
+    PRINT(percentGets);
+    PRINT(batchSize);
     cout<<endl;
     
     // check for too large thread count
@@ -261,24 +475,58 @@ int main(int argc, char** argv) {
         return 1;
     }
     
+    if (batchSize < 1 || batchSize > MAX_BATCH_SIZE) {
+        std::cout<<"ERROR: batchSize="<<batchSize<<" must be in [1, MAX_BATCH_SIZE="<<MAX_BATCH_SIZE<<"]"<<std::endl;
+        return 1;
+    }
+    
     // check for missing alg name
     if (alg == NULL) {
         cout<<"Must specify algorithm name"<<endl;
         return 1;
     }
+
+    // AlgorithmC, AlgorithmSwiss and AlgorithmD keep their flags in the top bits of each slot, so larger keys would be corrupted
+    if (!strcmp(alg, "C") && keyRangeSize > AlgorithmC<>::MAX_KEY) {
+        std::cout<<"ERROR: keyRangeSize="<<keyRangeSize<<" > AlgorithmC<>::MAX_KEY="<<AlgorithmC<>::MAX_KEY<<std::endl;
+        return 1;
+    }
+    if (!strcmp(alg, "S") && keyRangeSize > AlgorithmSwiss::MAX_KEY) {
+        std::cout<<"ERROR: keyRangeSize="<<keyRangeSize<<" > AlgorithmSwiss::MAX_KEY="<<AlgorithmSwiss::MAX_KEY<<std::endl;
+        return 1;
+    }
+    if (!strcmp(alg, "D") && keyRangeSize > AlgorithmD<>::MAX_KEY) {
+        std::cout<<"ERROR: keyRangeSize="<<keyRangeSize<<" > AlgorithmD<>::MAX_KEY="<<AlgorithmD<>::MAX_KEY<<std::endl;
+        return 1;
+    }
     
     // run experiment for the selected algorithm
     if (!strcmp(alg, "A")) {
-        runExperiment<AlgorithmA>(keyRangeSize, tableSize, millisToRun, totalThreads);
+        runExperimentWithHashPolicy<AlgorithmA>(hashPolicy, capacityPolicy, keyRangeSize, tableSize, millisToRun, totalThreads);
+    }
+	else if (!strcmp(alg, "AS")) {
+         runExperimentWithCapacityPolicy<AlgorithmAStriped>(capacityPolicy, keyRangeSize, tableSize, millisToRun, totalThreads);
     }
 	else if (!strcmp(alg, "B")) {
-         runExperiment<AlgorithmB>(keyRangeSize, tableSize, millisToRun, totalThreads);
+         runExperimentWithHashPolicy<AlgorithmB>(hashPolicy, capacityPolicy, keyRangeSize, tableSize, millisToRun, totalThreads);
     }
 	else if (!strcmp(alg, "C")) {
-         runExperiment<AlgorithmC>(keyRangeSize, tableSize, millisToRun, totalThreads);
+         runExperimentWithHashPolicy<AlgorithmC>(hashPolicy, capacityPolicy, keyRangeSize, tableSize, millisToRun, totalThreads);
     }
 	else if (!strcmp(alg, "D")) {
-         runExperiment<AlgorithmD>(keyRangeSize, tableSize, millisToRun, totalThreads);
+         runExperimentWithHashPolicy<AlgorithmD>(hashPolicy, capacityPolicy, keyRangeSize, tableSize, millisToRun, totalThreads);
+    }
+	else if (!strcmp(alg, "S")) {
+         runExperiment<AlgorithmSwiss>(keyRangeSize, tableSize, millisToRun, totalThreads);
+    }
+	else if (!strcmp(alg, "RH")) {
+         runExperimentWithCapacityPolicy<AlgorithmRobinHood>(capacityPolicy, keyRangeSize, tableSize, millisToRun, totalThreads);
+    }
+	else if (!strcmp(alg, "CK")) {
+         runExperimentWithCapacityPolicy<AlgorithmCuckoo>(capacityPolicy, keyRangeSize, tableSize, millisToRun, totalThreads);
+    }
+	else if (!strcmp(alg, "DM")) {
+         runExperimentWithCapacityPolicy<AlgorithmDMap>(capacityPolicy, keyRangeSize, tableSize, millisToRun, totalThreads);
     }
  	else {
         cout<<"Bad algorithm name: "<<alg<<endl;
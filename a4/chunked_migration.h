@@ -0,0 +1,126 @@
+#pragma once
+#include "util.h"
+#include <atomic>
+using namespace std;
+
+/**
+ * Cooperative, chunked migration, shared by AlgorithmD and AlgorithmDMap (see alg_d.h for how
+ * operations read through to the old table while it is being migrated), and by the tables that
+ * purge their tombstones by migrating into a new table of the same size (tombstone_purge.h).
+ *
+ * A table that replaces an old table inherits from MigratingTable, which splits the old table into
+ * chunks of CHUNK_SIZE slots. Threads help by claiming chunks (helpMigration), and once every chunk
+ * has been claimed, they steal (re-migrate) chunks whose claimers haven't finished, e.g., because
+ * they were descheduled (finishMigration). So nobody ever waits for the migration to finish.
+ * The tables supply the per-slot step, migrateSlot(index), which must be idempotent, and returns
+ * false if it couldn't place the slot's key in the new table (then the chunk isn't finished).
+ *
+ * Room for the migration: while the new table is migrating, operations may claim at most insertLimit
+ * of its slots (claimForInsert), and the rest must hold every key the migration can copy (see
+ * replaceTable). AlgorithmD and AlgorithmDMap size their new tables so those keys take at most a
+ * quarter of the slots, and let operations claim half. So the migration always finds an EMPTY slot
+ * for each key. An operation that would go past the limit finishes the migration instead (which
+ * never waits), and then retries.
+ */
+struct MigratingTable {
+    static const int CHUNK_SIZE = 4096;
+
+    int oldCapacity;
+    int totalOldChunks;
+    int insertLimit;                // slots that operations (not the migration) may claim while migrating
+    atomic<bool> * chunkMigrated;   // one flag per old chunk
+    atomic<bool> replacing;         // set once this table is to be replaced: inserts help replace it instead
+    char paddingMigration0[PADDING_BYTES];
+    atomic<int> chunksClaimed;
+    char paddingMigration1[PADDING_BYTES];
+    atomic<int> chunksDone;
+    char paddingMigration2[PADDING_BYTES];
+    atomic<int> insertClaims;       // slots claimed by operations while migrating (only counted then)
+    char paddingMigration3[PADDING_BYTES];
+
+    // the record manager default constructs records, and then we construct them in place (placement new)
+    MigratingTable() : chunkMigrated(nullptr) {}
+    MigratingTable(int _oldCapacity, int _insertLimit)
+    : oldCapacity(_oldCapacity), totalOldChunks((_oldCapacity + CHUNK_SIZE - 1) / CHUNK_SIZE), insertLimit(_insertLimit),
+      replacing(false), chunksClaimed(0), chunksDone(0), insertClaims(0) {
+        chunkMigrated = new atomic<bool>[max(totalOldChunks, 1)] {};
+    }
+    ~MigratingTable() {
+        delete [] chunkMigrated;
+    }
+    bool isMigrating() {
+        return chunksDone.load(memory_order_acquire) < totalOldChunks;
+    }
+
+    // call before an operation claims an EMPTY slot. returns false if the claim could take room
+    // that the migration needs: then the operation must finish the migration, and retry.
+    bool claimForInsert() {
+        if (!isMigrating()) return true;
+        return insertClaims.fetch_add(1, memory_order_relaxed) < insertLimit;
+    }
+
+    // claim and migrate one chunk of the old table (if any are left to claim)
+    template <class MigrateSlot>
+    void helpMigration(MigrateSlot migrateSlot) {
+        if (chunksClaimed.load(memory_order_relaxed) >= totalOldChunks) return;
+        int myChunk = chunksClaimed.fetch_add(1);
+        if (myChunk < totalOldChunks) migrateChunk(myChunk, migrateSlot);
+    }
+
+    // migrate every chunk of the old table that isn't finished, including chunks claimed by other threads
+    template <class MigrateSlot>
+    void finishMigration(MigrateSlot migrateSlot) {
+        while (chunksClaimed.load(memory_order_relaxed) < totalOldChunks) {
+            helpMigration(migrateSlot);
+        }
+        for (int chunk = 0; chunk < totalOldChunks && isMigrating(); ++chunk) {
+            if (!chunkMigrated[chunk].load(memory_order_acquire)) migrateChunk(chunk, migrateSlot); // steal
+        }
+    }
+
+    template <class MigrateSlot>
+    void migrateChunk(int chunk, MigrateSlot migrateSlot) {
+        int start = chunk * CHUNK_SIZE;
+        int end = min(start + CHUNK_SIZE, oldCapacity);
+        bool placedAll = true;
+        for (int idx = start; idx < end; ++idx){
+            if (!migrateSlot(idx)) placedAll = false;
+        }
+        // only the first thread to finish the chunk counts it
+        if (placedAll && !chunkMigrated[chunk].exchange(true)) chunksDone.fetch_add(1);
+    }
+};
+
+/**
+ * Replace t, if it is still the current table and shouldReplace() agrees, with newTable().
+ * t can only be replaced once nothing is left in ITS old table, so we finish t's migration first.
+ *
+ * Once we decide to replace t, we set t->replacing, and inserts that see it call replaceTable
+ * instead of claiming slots in t. So, after that, t only gets the inserts of operations that were
+ * already past that check (at most one per operation in flight). newTable() is called after that
+ * point, and must leave room in the new table for t's keys plus those inserts (see above), or
+ * return nullptr. Once t is replaced, its old table can't be reached by new operations,
+ * so it is retired (t itself is retired when the new table is replaced). migrateSlot(table, index)
+ * migrates slot index of table's old table. Returns true if t was replaced.
+ */
+template <class Table, class RecordManager, class ShouldReplace, class NewTable, class MigrateSlot>
+bool replaceTable(const int tid, atomic<Table *> & currentTable, RecordManager & tablemgr, Table * t,
+                  ShouldReplace shouldReplace, NewTable newTable, MigrateSlot migrateSlot) {
+    if (currentTable != t) return false;
+    t->finishMigration([&](int index) { return migrateSlot(t, index); }); // never waits: we steal unfinished chunks
+    if (t->isMigrating()) return false; // a key didn't fit in t, which its insertLimit rules out
+
+    if (!t->replacing) {
+        if (!shouldReplace()) return false;
+        t->replacing = true; // seq_cst: an insert that doesn't see this is already in flight
+    }
+    Table * newT = newTable();
+    if (newT == nullptr) return false;
+    if (!currentTable.compare_exchange_strong(t, newT)) {
+        tablemgr.deallocate(tid, newT); // never visible to other threads
+        return false;
+    }
+    if (t->oldTable != nullptr) tablemgr.retire(tid, t->oldTable);
+    newT->helpMigration([&](int index) { return migrateSlot(newT, index); });
+    return true;
+}
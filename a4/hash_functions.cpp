@@ -0,0 +1,158 @@
+/**
+ * Hash function microbenchmark: for every hash policy in util.h, on sequential, random
+ * and strided key sets, reports
+ *   - the cost of hashing (ns per hash, hashing every key of the set repeatedly), and
+ *   - the probe length distribution that the hashes produce: the keys are inserted (by one
+ *     thread) into a linear probing table with the chosen capacity policy, at the chosen
+ *     load factor, and we report the mean, 99th percentile and maximum number of slots each
+ *     insert looked at (1 means the key went into its home slot).
+ *
+ * Clustering can make linear probing quadratic (e.g., strided keys with IdentityHash), so a
+ * key set stops being inserted once it has used PROBE_BUDGET_PER_KEY probes per key on average,
+ * and its row reports how many keys were inserted before that happened.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "util.h"
+
+using namespace std;
+
+#ifndef PROBE_BUDGET_PER_KEY
+#define PROBE_BUDGET_PER_KEY 100
+#endif
+
+static const int HASH_REPETITIONS = 20;    // times each key set is hashed to measure the cost of hashing
+
+volatile uint32_t garbage; // "uses" the hashes, so hashing isn't optimized out
+
+template <class HashPolicy>
+double measureNanosPerHash(const vector<int> & keys) {
+    uint32_t sink = 0;
+    auto start = chrono::high_resolution_clock::now();
+    for (int rep=0;rep<HASH_REPETITIONS;++rep) {
+        for (int key : keys) sink ^= HashPolicy::hash(key);
+    }
+    auto end = chrono::high_resolution_clock::now();
+    garbage = sink;
+    return chrono::duration_cast<chrono::nanoseconds>(end - start).count() / (double) (HASH_REPETITIONS * keys.size());
+}
+
+template <class HashPolicy, class CapacityPolicy>
+void runKeySet(const char * keySetName, const vector<int> & keys, double loadFactor) {
+    int64_t capacity = CapacityPolicy::roundUp((int64_t) (keys.size() / loadFactor) + 1);
+    CapacityPolicy slots(capacity);
+    vector<int> data(capacity, 0);                // 0 is EMPTY (keys are at least 1)
+    vector<int64_t> probeCounts;                  // probeCounts[p] = number of inserts that looked at p slots
+
+    int64_t totalProbes = 0;
+    int64_t numInserted = 0;
+    for (int key : keys) {
+        if (totalProbes > PROBE_BUDGET_PER_KEY * (int64_t) keys.size()) break;
+        int64_t index = slots.home(HashPolicy::hash(key));
+        int64_t probes = 1;
+        while (data[index] != 0 && data[index] != key) {
+            index = slots.next(index);
+            ++probes;
+        }
+        data[index] = key;
+        if ((int64_t) probeCounts.size() <= probes) probeCounts.resize(probes + 1, 0);
+        ++probeCounts[probes];
+        totalProbes += probes;
+        ++numInserted;
+    }
+
+    int64_t p99 = 0;
+    for (int64_t p = 0, seen = 0; p < (int64_t) probeCounts.size(); ++p) {
+        seen += probeCounts[p];
+        if (seen * 100 >= numInserted * 99) { p99 = p; break; }
+    }
+    int64_t maxProbes = probeCounts.size() - 1;
+
+    printf("%-10s %-11s %8.2f %12.2f %11ld %11ld", HashPolicy::name(), keySetName,
+            measureNanosPerHash<HashPolicy>(keys), totalProbes / (double) numInserted, p99, maxProbes);
+    if (numInserted < (int64_t) keys.size()) {
+        printf("   (over budget: stopped after %ld of %ld keys)", numInserted, (int64_t) keys.size());
+    }
+    printf("\n");
+}
+
+template <class HashPolicy, class CapacityPolicy>
+void runHashPolicy(const vector<int> & sequential, const vector<int> & random, const vector<int> & strided, double loadFactor) {
+    runKeySet<HashPolicy, CapacityPolicy>("sequential", sequential, loadFactor);
+    runKeySet<HashPolicy, CapacityPolicy>("random", random, loadFactor);
+    runKeySet<HashPolicy, CapacityPolicy>("strided", strided, loadFactor);
+}
+
+template <class CapacityPolicy>
+void runAllHashPolicies(int numKeys, int stride, double loadFactor) {
+    vector<int> sequential;
+    vector<int> random;
+    vector<int> strided;
+    PaddedRandom rng(1);
+    for (int i=1;i<=numKeys;++i) {
+        sequential.push_back(i);
+        random.push_back(1 + (rng.nextNatural() % 0x3FFFFFFF)); // the key range of AlgorithmD
+        strided.push_back(i * stride);
+    }
+
+    printf("%-10s %-11s %8s %12s %11s %11s\n", "hash", "keys", "ns/hash", "mean_probes", "p99_probes", "max_probes");
+    runHashPolicy<Murmur3Hash, CapacityPolicy>(sequential, random, strided, loadFactor);
+    runHashPolicy<CRC32CHash, CapacityPolicy>(sequential, random, strided, loadFactor);
+    runHashPolicy<MultiplyShiftHash, CapacityPolicy>(sequential, random, strided, loadFactor);
+    runHashPolicy<IdentityHash, CapacityPolicy>(sequential, random, strided, loadFactor);
+}
+
+int main(int argc, char** argv) {
+    int numKeys = 1000000;
+    int stride = 64;
+    double loadFactor = 0.5;
+    const char * capacityPolicy = ModuloCapacity::name();
+
+    // read command line args
+    for (int i=1;i<argc;++i) {
+        if (strcmp(argv[i], "-n") == 0) {
+            numKeys = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0) {
+            stride = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-lf") == 0) {
+            loadFactor = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-cp") == 0) {
+            capacityPolicy = argv[++i];
+        } else {
+            cout<<"USAGE: "<<argv[0]<<" [options]"<<endl;
+            cout<<"Options:"<<endl;
+            cout<<"    -n  [int]      [n]umber of keys in each key set [default 1000000]"<<endl;
+            cout<<"    -s  [int]      [s]tride of the strided key set (keys s, 2s, 3s, ...) [default 64]"<<endl;
+            cout<<"    -lf [double]   [l]oad [f]actor of the table the keys are inserted into [default 0.5]"<<endl;
+            cout<<"    -cp [string]   [c]apacity [p]olicy in { mod, pow2, fastrange } [default mod] (pow2 rounds the table size up)"<<endl;
+            return 1;
+        }
+    }
+    if (numKeys < 1 || stride < 1 || (int64_t) numKeys * stride > INT_MAX || loadFactor <= 0 || loadFactor >= 1) {
+        cout<<"ERROR: need numKeys >= 1, stride >= 1, numKeys * stride <= INT_MAX and 0 < loadFactor < 1"<<endl;
+        return 1;
+    }
+
+    PRINT(numKeys);
+    PRINT(stride);
+    PRINT(loadFactor);
+    PRINT(capacityPolicy);
+    PRINT(PROBE_BUDGET_PER_KEY);
+    cout<<endl;
+
+    if (!strcmp(capacityPolicy, ModuloCapacity::name())) {
+        runAllHashPolicies<ModuloCapacity>(numKeys, stride, loadFactor);
+    } else if (!strcmp(capacityPolicy, PowerOfTwoCapacity::name())) {
+        runAllHashPolicies<PowerOfTwoCapacity>(numKeys, stride, loadFactor);
+    } else if (!strcmp(capacityPolicy, FastRangeCapacity::name())) {
+        runAllHashPolicies<FastRangeCapacity>(numKeys, stride, loadFactor);
+    } else {
+        cout<<"Bad capacity policy: "<<capacityPolicy<<endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include "util.h"
+#include "chunked_migration.h"
+#include <atomic>
+using namespace std;
+
+#ifndef TOMBSTONE_PURGE_FRACTION
+#define TOMBSTONE_PURGE_FRACTION 8 // purge tombstones once more than capacity/TOMBSTONE_PURGE_FRACTION slots hold them
+#endif
+
+/**
+ * Cooperative, non-blocking tombstone purging for the open addressing tables that never expand
+ * (AlgorithmC and AlgorithmSwiss).
+ *
+ * Slots use AlgorithmD's layout: the low 30 bits hold a key, and two flag bits track its state.
+ *   DELETED_MASK   key was erased. the slot keeps the key (a later insert of the key revives it),
+ *                  so a key has at most one slot per table. these are the tables' tombstones.
+ *   MARKED_MASK    slot is frozen because this table is being purged (migrated to a new table).
+ *
+ * A purge replaces the table with a new table of the same capacity, into which only the live keys
+ * are migrated, exactly as AlgorithmD migrates a table when it resizes (chunked_migration.h, and see
+ * alg_d.h for how operations read through to the old table). So nobody waits for a purge: operations
+ * keep running, help migrate chunks, and steal the chunks of descheduled threads. The price is a
+ * second array of the same size, until the migration is done and the old one is freed.
+ *
+ * A table is purged once more than capacity/TOMBSTONE_PURGE_FRACTION of its slots hold deleted keys.
+ * Operations only read the approximate count of erases: the deleted slots (erases minus revives)
+ * are only counted accurately once the erases alone could have made enough of them. Until then, an
+ * insert that finds no EMPTY slot for its key fails, as if the table were full.
+ */
+struct PurgeableTable : MigratingTable {
+    enum {
+        MARKED_MASK = (int) 0x80000000,     // most significant bit of a 32-bit key
+        DELETED_MASK = (int) 0x40000000,
+        KEY_MASK = (int) 0x3FFFFFFF,
+        EMPTY = (int) 0
+    };
+    static const int64_t STALENESS_NS = 1000000; // how stale a count of erases can be when an operation has probed far
+
+    char paddingPurge0[PADDING_BYTES];
+    counter * approxDeletes;        // erases done in this table
+    counter * approxRevives;        // inserts that revived a deleted slot in this table
+    char paddingPurge1[PADDING_BYTES];
+    atomic<int64_t> nextCheck;      // the number of erases at which there may be enough deleted slots to purge
+    char paddingPurge2[PADDING_BYTES];
+
+    // the record manager default constructs records, and then we construct them in place (placement new)
+    PurgeableTable() : approxDeletes(nullptr), approxRevives(nullptr) {}
+    PurgeableTable(int numThreads, int capacity, int _oldCapacity, int _insertLimit)
+    : MigratingTable(_oldCapacity, _insertLimit), nextCheck(capacity / TOMBSTONE_PURGE_FRACTION) {
+        approxDeletes = new counter(numThreads);
+        approxRevives = new counter(numThreads);
+    }
+    ~PurgeableTable() {
+        delete approxDeletes;
+        delete approxRevives;
+    }
+
+    // whether to check if the table should be purged, according to the approximate (never too large) count of erases.
+    // once an operation has probed more than 10 slots, the count can be up to STALENESS_NS old instead of lagging by
+    // per-thread batches
+    bool isPurgeNeeded(int probes) {
+        int64_t limit = nextCheck.load(memory_order_relaxed);
+        return approxDeletes->get() > limit || (probes > 10 && approxDeletes->readWithin(STALENESS_NS) > limit);
+    }
+
+    // the accurate check, for a thread that is about to purge
+    bool shouldPurge(int capacity) {
+        int64_t revives = approxRevives->getAccurate(); // before the erases, so we never undercount deleted slots
+        int64_t deletes = approxDeletes->getAccurate();
+        int64_t deleted = deletes - revives;
+        int64_t limit = capacity / TOMBSTONE_PURGE_FRACTION;
+        if (deleted > limit) return true;
+        // each erase deletes at most one slot, so don't check again until there can be enough deleted slots
+        nextCheck.store(deletes + limit - deleted, memory_order_relaxed);
+        return false;
+    }
+
+    // the slots of a new table that operations may claim while it migrates keysToMigrate keys (see chunked_migration.h)
+    static int insertLimitFor(int capacity, int64_t keysToMigrate) {
+        return (int) max((int64_t) 0, capacity - keysToMigrate);
+    }
+
+    // the number of live keys in data (exact if nobody is changing it)
+    static int64_t countLive(atomic<int> * data, int capacity) {
+        int64_t live = 0;
+        for (int i = 0; i < capacity; ++i){
+            int found = data[i];
+            if ((found & KEY_MASK) != EMPTY && !(found & DELETED_MASK)) ++live;
+        }
+        return live;
+    }
+
+    // freeze slot index of old, and copyKey(key) into the new table if it holds a live key. idempotent,
+    // because copyKey does nothing if the new table already has a slot for key (live or deleted).
+    // returns false if the key didn't fit in the new table (then the slot is left to be migrated again).
+    template <class CopyKey>
+    static bool migrateSlot(atomic<int> * old, int index, CopyKey copyKey) {
+        int found = old[index].fetch_or(MARKED_MASK) | MARKED_MASK;
+        if ((found & KEY_MASK) == EMPTY || (found & DELETED_MASK)) return true; // nothing (left) to copy
+
+        if (!copyKey(found & KEY_MASK)) return false;
+        // record that the copy is done, so nobody copies it again. nothing else writes a frozen slot,
+        // and every thread that gets here writes the same value, so this doesn't need a CAS
+        old[index].store(found | DELETED_MASK, memory_order_release);
+        return true;
+    }
+};
@@ -4,6 +4,11 @@
 #include <chrono>
 #include <atomic>
 #include <sstream>
+#include <cassert>
+#include <climits>
+#include <ctime>
+#include <immintrin.h>
+#include "../a7/common/spin_park.h"
 using namespace std;
 
 #ifndef MAX_THREADS
@@ -36,6 +41,10 @@ using namespace std;
 #define PRINT(name) { cout<<(#name)<<"="<<name<<endl; }
 #endif
 
+#ifndef BATCH_INFLIGHT
+#define BATCH_INFLIGHT 16               // keys a batched operation has prefetched but not yet resolved
+#endif
+
 struct PaddedInt64 {
     volatile int64_t v;
     char padding[PADDING_BYTES - sizeof(v)];
@@ -50,8 +59,17 @@ private:
     char padding1[64];
     const int numThreads;
     char padding2[64];
+    // cached result of getAccurate(), refreshed by readWithin()
+    atomic<int64_t> snapshotValue;
+    atomic<int64_t> snapshotTimeNs;
+    atomic<bool> refreshing;
+    char padding3[64];
+
+    static int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
 public:
-    counter(int _numThreads) : numThreads(_numThreads), globalCounter(0) {
+    counter(int _numThreads) : numThreads(_numThreads), globalCounter(0), snapshotValue(0), snapshotTimeNs(0), refreshing(false) {
         for (int i=0;i<MAX_THREADS;++i) subcounters[i].v = 0;
     }
     int64_t inc(int tid) {
@@ -73,6 +91,22 @@ public:
         ret += globalCounter;
         return ret;
     }
+    // like getAccurate(), but may return a value computed up to maxStalenessNs ago.
+    // only one thread at a time rescans the subcounters; concurrent callers get the previous snapshot.
+    int64_t readWithin(int64_t maxStalenessNs) {
+        int64_t now = nowNs();
+        if (now - snapshotTimeNs.load(memory_order_acquire) <= maxStalenessNs) {
+            return snapshotValue.load(memory_order_relaxed);
+        }
+        if (refreshing.load(memory_order_relaxed) || refreshing.exchange(true, memory_order_acquire)) {
+            return snapshotValue.load(memory_order_relaxed);
+        }
+        int64_t ret = getAccurate();
+        snapshotValue.store(ret, memory_order_relaxed);
+        snapshotTimeNs.store(now, memory_order_release);
+        refreshing.store(false, memory_order_release);
+        return ret;
+    }
 };
 
 class ElapsedTimer {
@@ -181,5 +215,83 @@ uint32_t murmur3(uint32_t key) {
     return h;
 }
 
+/**
+ * Capacity policies: how a hash table maps a hash to the first slot of its probe
+ * sequence, and how it steps to the next slot (wrapping around at the end).
+ * Tables take one as a template parameter, and must only use capacities returned
+ * by roundUp(). Only home() reduces a hash, so probing never divides.
+ *
+ *   ModuloCapacity      any capacity, home = h % capacity (one integer divide per operation)
+ *   PowerOfTwoCapacity  rounds capacities up to a power of two, home = h & (capacity-1)
+ *   FastRangeCapacity   any capacity, home = (h * capacity) >> 32 (Lemire's fast range reduction)
+ */
+struct ModuloCapacity {
+    int64_t capacity;
+    static const char * name() { return "mod"; }
+    static int64_t roundUp(int64_t c) { return c; }
+    ModuloCapacity(int64_t _capacity = 1) : capacity(_capacity) {}
+    inline int64_t home(uint32_t h) const { return h % capacity; }
+    inline int64_t next(int64_t i) const { return (i+1 == capacity) ? 0 : i+1; }
+};
+
+struct PowerOfTwoCapacity {
+    int64_t mask;
+    static const char * name() { return "pow2"; }
+    static int64_t roundUp(int64_t c) {
+        int64_t p = 1;
+        while (p < c) p <<= 1;
+        return p;
+    }
+    PowerOfTwoCapacity(int64_t _capacity = 1) : mask(_capacity - 1) {
+        assert((_capacity & mask) == 0);
+    }
+    inline int64_t home(uint32_t h) const { return h & mask; }
+    inline int64_t next(int64_t i) const { return (i+1) & mask; }
+};
+
+struct FastRangeCapacity {
+    int64_t capacity;
+    static const char * name() { return "fastrange"; }
+    static int64_t roundUp(int64_t c) { return c; }
+    FastRangeCapacity(int64_t _capacity = 1) : capacity(_capacity) {
+        assert(capacity <= (1LL<<32));
+    }
+    // uses the HIGH bits of h, so it needs a hash policy that mixes them (i.e., not IdentityHash)
+    inline int64_t home(uint32_t h) const { return (int64_t) (((uint64_t) h * (uint64_t) capacity) >> 32); }
+    inline int64_t next(int64_t i) const { return (i+1 == capacity) ? 0 : i+1; }
+};
+
+/**
+ * Hash policies: how a hash table turns a key into the 32-bit hash that its capacity
+ * policy maps to a slot. Tables take one as a template parameter (after the capacity policy).
+ *
+ *   Murmur3Hash         the murmur3 finalizer above (full avalanche: every key bit affects every hash bit)
+ *   CRC32CHash          one SSE4.2 crc32 instruction (needs -msse4.2). mixes well, but is linear,
+ *                       so keys that differ in the same bits have hashes that differ in the same bits
+ *   MultiplyShiftHash   the high half of key times a 64-bit odd constant (Fibonacci hashing).
+ *                       cheap, and its high bits are well mixed, so it suits FastRangeCapacity best
+ *   IdentityHash        the key itself. free, and fine for dense keys with ModuloCapacity,
+ *                       but strided keys collide (e.g., multiples of 64 with PowerOfTwoCapacity)
+ */
+struct Murmur3Hash {
+    static const char * name() { return "murmur3"; }
+    static inline uint32_t hash(uint32_t key) { return murmur3(key); }
+};
+
+struct CRC32CHash {
+    static const char * name() { return "crc32c"; }
+    static inline uint32_t hash(uint32_t key) { return _mm_crc32_u32(0x1a8b714c, key); }
+};
+
+struct MultiplyShiftHash {
+    static const char * name() { return "multshift"; }
+    static inline uint32_t hash(uint32_t key) { return (uint32_t) ((key * 0x9E3779B97F4A7C15ULL) >> 32); }
+};
+
+struct IdentityHash {
+    static const char * name() { return "identity"; }
+    static inline uint32_t hash(uint32_t key) { return key; }
+};
+
 #endif /* UTIL_H */
 
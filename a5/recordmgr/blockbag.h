@@ -343,7 +343,7 @@ class block;
         
         inline void incrementReclaimCount() {
             SOFTWARE_BARRIER;
-            ++reclaimCount;
+            reclaimCount = reclaimCount + 1;
             SOFTWARE_BARRIER;
         }
         inline long long getReclaimCount() {
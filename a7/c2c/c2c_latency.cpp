@@ -0,0 +1,176 @@
+/**
+ * Core-to-core latency matrix: for every pair of logical processors, two
+ * threads (pinned with binding_bindThread) bounce one cache line back and
+ * forth, and we report the average round trip time (two cache line transfers).
+ *
+ * Prints the matrix, followed by a suggested thread pinning order: starting
+ * from the first processor, repeatedly add the processor with the lowest
+ * latency to any processor already chosen. This fills SMT siblings, then the
+ * rest of a socket, then the next closest socket, and so on.
+ * The LAST line of output is the order in the format parsed by -pin
+ * (binding_parseCustom in binding.h), so it can be used directly, e.g.,
+ *
+ *     ../tree/benchmark ... -pin `./c2c_latency | tail -1`
+ */
+
+#include <thread>
+#include <cstdlib>
+#include <atomic>
+#include <string>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <unistd.h>
+
+#include "util.h"
+#include "binding.h"
+
+using namespace std;
+
+struct globals_t {
+    volatile char padding0[PADDING_BYTES];
+    atomic<int64_t> line;       // the cache line that bounces between the two threads
+    volatile char padding1[PADDING_BYTES];
+    atomic<int> ready;          // both threads are pinned
+    volatile char padding2[PADDING_BYTES];
+} __attribute__((aligned(PADDING_BYTES)));
+
+// returns the average round trip time (in ns) between the processors that
+// binding.h assigns to threads tidA and tidB (the minimum over numBatches batches)
+double measurePair(globals_t * g, int tidA, int tidB, int roundTrips, int numBatches) {
+    double best = -1;
+    for (int batch=0;batch<numBatches;++batch) {
+        g->line = 0;
+        g->ready = 0;
+        int64_t elapsedNs = 0;
+
+        thread pong([&]() {
+            binding_bindThread(tidB);
+            g->ready.fetch_add(1);
+            for (int64_t i=0;i<roundTrips;++i) {
+                while (g->line.load(memory_order_acquire) != 2*i+1) {}
+                g->line.store(2*i+2, memory_order_release);
+            }
+        });
+        thread ping([&]() {
+            binding_bindThread(tidA);
+            g->ready.fetch_add(1);
+            while (g->ready.load() < 2) {}
+            auto start = std::chrono::steady_clock::now();
+            for (int64_t i=0;i<roundTrips;++i) {
+                g->line.store(2*i+1, memory_order_release);
+                while (g->line.load(memory_order_acquire) != 2*i+2) {}
+            }
+            auto end = std::chrono::steady_clock::now();
+            elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        });
+        ping.join();
+        pong.join();
+
+        double ns = elapsedNs / (double) roundTrips;
+        if (best < 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+// format an order such as 0,1,2,3,8,5 as "0-3,8,5"
+string toPinPattern(const vector<int> & order) {
+    stringstream ss;
+    int n = order.size();
+    for (int i=0;i<n;) {
+        int j = i;
+        while (j+1 < n && order[j+1] == order[j]+1) ++j;
+        if (i > 0) ss<<",";
+        ss<<order[i];
+        if (j > i) ss<<"-"<<order[j];
+        i = j+1;
+    }
+    return ss.str();
+}
+
+int main(int argc, char** argv) {
+    int roundTrips = 10000;
+    int numBatches = 3;
+    string cpus = "";
+
+    // read command line args
+    for (int i=1;i<argc;++i) {
+        if (strcmp(argv[i], "-r") == 0) {
+            roundTrips = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-b") == 0) {
+            numBatches = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-cpus") == 0) {
+            cpus = argv[++i];
+        } else {
+            cout<<"USAGE: "<<argv[0]<<" [options]"<<endl;
+            cout<<"Options:"<<endl;
+            cout<<"    -r    [int]      round trips per measurement [default 10000]"<<endl;
+            cout<<"    -b    [int]      measurements per pair (the minimum is reported) [default 3]"<<endl;
+            cout<<"    -cpus [pattern]  logical processors to measure, in -pin format [default: all online processors]"<<endl;
+            cout<<endl;
+            cout<<"The last line of output is a suggested -pin pattern."<<endl;
+            cout<<"Example: "<<argv[0]<<" -r 20000 -cpus 0-23,48-71"<<endl;
+            return 1;
+        }
+    }
+    if (cpus.empty()) {
+        cpus = "0-" + to_string(sysconf(_SC_NPROCESSORS_ONLN) - 1);
+    }
+
+    // thread tid is bound to the tid-th processor in the pattern
+    binding_parseCustom(cpus);
+    int n = numCustomBindings;
+    if (n < 1 || n > MAX_THREADS) {
+        cout<<"ERROR: number of processors="<<n<<" must be in [1, MAX_THREADS="<<MAX_THREADS<<"]"<<endl;
+        return 1;
+    }
+    binding_configurePolicy(n);
+
+    auto g = new globals_t();
+    vector<vector<double>> latency(n, vector<double>(n, 0));
+    for (int a=0;a<n;++a) {
+        for (int b=a+1;b<n;++b) {
+            latency[a][b] = latency[b][a] = measurePair(g, a, b, roundTrips, numBatches);
+        }
+    }
+    delete g;
+
+    // print the matrix (round trip ns; row and column labels are processor ids)
+    cout<<"round trip latency (ns):"<<endl;
+    cout<<setw(6)<<"cpu";
+    for (int b=0;b<n;++b) cout<<" "<<setw(7)<<customBinding[b];
+    cout<<endl;
+    for (int a=0;a<n;++a) {
+        cout<<setw(6)<<customBinding[a];
+        for (int b=0;b<n;++b) {
+            if (a == b) cout<<" "<<setw(7)<<"-";
+            else cout<<" "<<setw(7)<<fixed<<setprecision(1)<<latency[a][b];
+        }
+        cout<<endl;
+    }
+    cout<<endl;
+
+    // greedy order: always add the processor closest to the set chosen so far
+    vector<bool> chosen(n, false);
+    vector<double> distance(n, 0);
+    vector<int> order;
+    chosen[0] = true;
+    order.push_back(customBinding[0]);
+    for (int b=1;b<n;++b) distance[b] = latency[0][b];
+    for (int k=1;k<n;++k) {
+        int next = -1;
+        for (int b=0;b<n;++b) {
+            if (!chosen[b] && (next < 0 || distance[b] < distance[next])) next = b;
+        }
+        chosen[next] = true;
+        order.push_back(customBinding[next]);
+        for (int b=0;b<n;++b) distance[b] = min(distance[b], latency[next][b]);
+    }
+
+    binding_deinit();
+    cout<<"suggested -pin pattern (closest processors first):"<<endl;
+    cout<<toPinPattern(order)<<endl;
+    return 0;
+}
@@ -0,0 +1,169 @@
+/**
+ * BRAVO reader-writer lock (Dice & Kogan, "BRAVO: Biased Locking for
+ * Reader-Writer Locks", USENIX ATC 2019).
+ *
+ * Wraps a simple writer-preferring reader-writer lock. While the lock is
+ * reader-biased (rbias), a reader does not touch the lock at all: it publishes
+ * the lock's address in one slot of a global visible readers table (chosen by
+ * hashing the lock and the reader's tid) and is done. Readers on different
+ * cores therefore write to different cache lines (in the common case).
+ *
+ * A writer first acquires the underlying lock, and then, if the lock is
+ * reader-biased, revokes the bias: it clears rbias and waits until no slot in
+ * the table refers to this lock. Revocation is expensive (it scans the whole
+ * table), so after a revocation, readers may not re-enable the bias until
+ * BRAVO_INHIBIT_MULTIPLIER times the revocation's duration has elapsed. This
+ * bounds the slowdown writers can suffer in write-heavy phases.
+ *
+ * Readers that find the bias off (or their slot taken) use the underlying lock,
+ * and may turn the bias back on once the inhibition period is over.
+ *
+ * Interface: the exclusive (write) interface of the locks in locks.h, plus
+ *
+ *     void readLock(const int tid);
+ *     bool readUnlock(const int tid);  // true if the reader used the underlying lock (i.e., isHeld() may change)
+ *     bool isWriteHeld();          // for TLE: transactions that only READ subscribe to this
+ *     bool isReaderBiased();       // for TLE: transactions that WRITE must not run while this is true
+ *
+ * (isHeld() is true if the underlying lock is held in either mode, and does
+ * NOT see readers in the visible readers table; see isReaderBiased().)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include "locks.h"
+
+#ifndef BRAVO_TABLE_SIZE
+#define BRAVO_TABLE_SIZE 4096           // slots in the (global) visible readers table (must be a power of two)
+#endif
+
+#ifndef BRAVO_INHIBIT_MULTIPLIER
+#define BRAVO_INHIBIT_MULTIPLIER 9      // after a revocation, keep the bias off for this many times as long as the revocation took
+#endif
+
+// shared by all BRAVOLocks (one table, as in the paper, so its size doesn't grow with the number of locks)
+static atomic<void *> bravoVisibleReaders[BRAVO_TABLE_SIZE];
+
+class BRAVOLock {
+private:
+    enum { WRITER = 1, READER = 2 }; // underlying lock word: WRITER bit + (number of slow-path readers) * READER
+
+    struct PaddedSlotPtr {
+        atomic<void *> * slot;    // slot in bravoVisibleReaders this thread published to (nullptr if it took the slow path)
+        char padding[PADDING_BYTES - sizeof(atomic<void *> *)];
+    };
+
+    char padding0[PADDING_BYTES];
+    atomic<bool> rbias;
+    char padding1[PADDING_BYTES];
+    atomic<int64_t> word;
+    char padding2[PADDING_BYTES];
+    TicketLock writers;             // serializes writers (so they acquire the underlying lock in FIFO order)
+    int64_t inhibitUntilNs;         // protected by the underlying lock: bias can't be re-enabled before this time
+    char padding3[PADDING_BYTES];
+    PaddedSlotPtr readerSlots[MAX_THREADS];
+    char padding4[PADDING_BYTES];
+
+    static int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    atomic<void *> * slotFor(const int tid) {
+        uint64_t h = ((uint64_t) this) ^ ((uint64_t) (tid+1) * 0x9E3779B97F4A7C15ULL);
+        h ^= h >> 29;
+        h *= 0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 32;
+        return &bravoVisibleReaders[h & (BRAVO_TABLE_SIZE-1)];
+    }
+    // called by a writer that holds the underlying lock
+    void revokeBias() {
+        int64_t start = nowNs();
+        rbias.store(false); // seq_cst: a fast reader either sees this, or we see its slot
+        for (int i=0;i<BRAVO_TABLE_SIZE;++i) {
+            int backoff = 1;
+            while (bravoVisibleReaders[i].load() == this) {
+                spinPause(backoff);
+                if (backoff < 1024) backoff <<= 1;
+            }
+        }
+        int64_t end = nowNs();
+        inhibitUntilNs = end + (end - start) * BRAVO_INHIBIT_MULTIPLIER;
+    }
+    void readLockSlow() {
+        int backoff = 1;
+        while (true) {
+            while (word.load(memory_order_relaxed) & WRITER) {
+                spinPause(backoff);
+                if (backoff < 1024) backoff <<= 1;
+            }
+            if (!(word.fetch_add(READER) & WRITER)) return;
+            word.fetch_add(-READER); // a writer got in first (writers have priority)
+        }
+    }
+
+public:
+    BRAVOLock(const int _numThreads = MAX_THREADS) : rbias(true), word(0), inhibitUntilNs(0) {
+        for (int i=0;i<MAX_THREADS;++i) readerSlots[i].slot = nullptr;
+    }
+    void readLock(const int tid) {
+        if (rbias.load()) {
+            atomic<void *> * slot = slotFor(tid);
+            void * expected = nullptr;
+            if (slot->load(memory_order_relaxed) == nullptr && slot->compare_exchange_strong(expected, (void *) this)) {
+                if (rbias.load()) { // recheck: a writer may have revoked the bias before it could see our slot
+                    readerSlots[tid].slot = slot;
+                    return;
+                }
+                slot->store(nullptr);
+            }
+        }
+        readLockSlow();
+        if (!rbias.load(memory_order_relaxed) && nowNs() >= inhibitUntilNs) {
+            rbias.store(true); // safe: we hold the underlying lock in read mode, so there is no writer to race with
+        }
+    }
+    bool readUnlock(const int tid) {
+        atomic<void *> * slot = readerSlots[tid].slot;
+        if (slot) {
+            readerSlots[tid].slot = nullptr;
+            slot->store(nullptr, memory_order_release);
+            return false;
+        }
+        word.fetch_add(-READER);
+        return true;
+    }
+    void lock(const int tid) {
+        writers.lock(tid);
+        word.fetch_or(WRITER);
+        int backoff = 1;
+        while (word.load() != WRITER) { // wait for slow-path readers to drain
+            spinPause(backoff);
+            if (backoff < 1024) backoff <<= 1;
+        }
+        if (rbias.load()) revokeBias();
+    }
+    bool tryLock(const int tid) {
+        if (!writers.tryLock(tid)) return false;
+        int64_t expected = 0;
+        if (!word.compare_exchange_strong(expected, WRITER)) {
+            writers.unlock(tid);
+            return false;
+        }
+        if (rbias.load()) revokeBias();
+        return true;
+    }
+    void unlock(const int tid) {
+        word.fetch_and(~WRITER);
+        writers.unlock(tid);
+    }
+    bool isHeld() {
+        return word.load(memory_order_relaxed) != 0;
+    }
+    bool isWriteHeld() {
+        return (word.load(memory_order_relaxed) & WRITER) != 0;
+    }
+    bool isReaderBiased() {
+        return rbias.load(memory_order_relaxed);
+    }
+};
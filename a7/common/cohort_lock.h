@@ -0,0 +1,123 @@
+/**
+ * NUMA-aware cohort lock (Dice, Marathe & Shavit, "Lock Cohorting", PPoPP 2012).
+ *
+ * Each NUMA node (socket) has its own local lock, and there is one global lock.
+ * A thread first acquires its socket's local lock. If the previous owner of the
+ * local lock handed the global lock over to the cohort, it is done; otherwise it
+ * acquires the global lock as well. On release, if other threads on the same
+ * socket are waiting, the global lock is passed to them (without releasing it),
+ * at most MAX_LOCAL_HANDOFFS times in a row, so the lock (and the data it
+ * protects) stays in one socket's caches instead of bouncing on every handoff.
+ *
+ * Both component locks are ticket locks: the global lock must be thread-oblivious
+ * (it may be released by a different thread than the one that acquired it), and
+ * the local lock must be able to tell whether anyone is waiting behind us.
+ *
+ * Implements the same interface as the locks in locks.h.
+ * Requires numa_tools.h (and -lnuma) to find the caller's socket.
+ */
+
+#pragma once
+
+#include "locks.h"
+#include "numa_tools.h"
+
+#ifndef MAX_LOCAL_HANDOFFS
+#define MAX_LOCAL_HANDOFFS 64
+#endif
+
+class CohortLock {
+private:
+    // local ticket lock with "is anyone waiting?" detection
+    struct LocalLock {
+        char padding0[PADDING_BYTES];
+        atomic<int64_t> nextTicket;
+        char padding1[PADDING_BYTES];
+        atomic<int64_t> nowServing;
+        bool globalPassed;      // protected by the local lock: did the previous owner leave the global lock to us?
+        int handoffs;           // protected by the local lock: consecutive local handoffs of the global lock
+        char padding2[PADDING_BYTES];
+
+        void lock() {
+            int64_t myTicket = nextTicket.fetch_add(1);
+            while (true) {
+                int64_t serving = nowServing.load(memory_order_acquire);
+                if (serving == myTicket) return;
+                spinPause(32 * (myTicket - serving));
+            }
+        }
+        bool tryLock() {
+            int64_t serving = nowServing.load(memory_order_acquire);
+            int64_t expected = serving;
+            return nextTicket.compare_exchange_strong(expected, serving+1);
+        }
+        void unlock() {
+            nowServing.store(nowServing.load(memory_order_relaxed) + 1, memory_order_release);
+        }
+        bool hasWaiters() {
+            return nextTicket.load(memory_order_relaxed) - nowServing.load(memory_order_relaxed) > 1;
+        }
+    };
+    struct PaddedInt {
+        int v;
+        char padding[PADDING_BYTES - sizeof(int)];
+    };
+
+    char padding0[PADDING_BYTES];
+    TicketLock global;
+    LocalLock * locals;         // one per NUMA node
+    int numNodes;
+    char padding1[PADDING_BYTES];
+    PaddedInt ownerNode[MAX_THREADS]; // node whose local lock tid acquired (so unlock uses the same one even if tid migrated)
+    char padding2[PADDING_BYTES];
+
+    int myNode(const int tid) {
+        int node = __numa.get_node_periodic();
+        if (node < 0) node = __numa.get_node_slow();
+        return ownerNode[tid].v = node % numNodes;
+    }
+public:
+    CohortLock(const int _numThreads = MAX_THREADS) {
+        numNodes = max(1, __numa.get_num_nodes());
+        locals = new LocalLock[numNodes];
+        for (int i=0;i<numNodes;++i) {
+            locals[i].nextTicket = 0;
+            locals[i].nowServing = 0;
+            locals[i].globalPassed = false;
+            locals[i].handoffs = 0;
+        }
+    }
+    ~CohortLock() {
+        delete[] locals;
+    }
+    void lock(const int tid) {
+        LocalLock & local = locals[myNode(tid)];
+        local.lock();
+        if (local.globalPassed) return; // the global lock was handed to our cohort
+        global.lock(tid);
+    }
+    bool tryLock(const int tid) {
+        LocalLock & local = locals[myNode(tid)];
+        if (!local.tryLock()) return false;
+        if (local.globalPassed) return true;
+        if (global.tryLock(tid)) return true;
+        local.unlock();
+        return false;
+    }
+    void unlock(const int tid) {
+        LocalLock & local = locals[ownerNode[tid].v];
+        if (local.hasWaiters() && local.handoffs < MAX_LOCAL_HANDOFFS) {
+            // keep the global lock in this socket
+            local.globalPassed = true;
+            ++local.handoffs;
+        } else {
+            local.globalPassed = false;
+            local.handoffs = 0;
+            global.unlock(tid);
+        }
+        local.unlock();
+    }
+    bool isHeld() {
+        return global.isHeld();
+    }
+};
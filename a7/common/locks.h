@@ -0,0 +1,291 @@
+/**
+ * Lock library.
+ *
+ * Every lock here has the same interface, so they can be swapped for one
+ * another as template arguments (e.g., as the fallback lock of a TLE data structure):
+ *
+ *     void lock(const int tid);
+ *     void unlock(const int tid);
+ *     bool tryLock(const int tid);   // acquire only if the lock is free right now
+ *     bool isHeld();                 // for TLE: transactions subscribe to the lock by reading this
+ *
+ * tid must be in [0, numThreads), where numThreads is passed to the constructor
+ * (and defaults to MAX_THREADS).
+ *
+ * TTASLock        test-and-test-and-set (global spinning, baseline)
+ * TicketLock      FIFO, one fetch&add per acquisition, everyone spins on now_serving
+ * MCSLock         FIFO queue lock, each thread spins on its OWN queue node
+ * CLHLock         FIFO queue lock, each thread spins on its predecessor's node
+ * TournamentLock  binary tree of two-thread Peterson locks (no read-modify-write instructions)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <immintrin.h>
+#include "util.h"
+
+// spin for a while, executing pause instructions (exponential backoff helper)
+static inline void spinPause(int iterations) {
+    for (int i=0;i<iterations;++i) _mm_pause();
+}
+
+class TTASLock {
+private:
+    char padding0[PADDING_BYTES];
+    atomic<int> state;
+    char padding1[PADDING_BYTES];
+public:
+    TTASLock(const int _numThreads = MAX_THREADS) : state(0) {}
+    bool tryLock(const int tid) {
+        int expected = 0;
+        return state.load(memory_order_relaxed) == 0 && state.compare_exchange_strong(expected, 1);
+    }
+    void lock(const int tid) {
+        int backoff = 1;
+        while (!tryLock(tid)) {
+            while (state.load(memory_order_relaxed)) {
+                spinPause(backoff);
+                if (backoff < 1024) backoff <<= 1;
+            }
+        }
+    }
+    void unlock(const int tid) {
+        state.store(0, memory_order_release);
+    }
+    bool isHeld() {
+        return state.load(memory_order_relaxed) != 0;
+    }
+};
+
+class TicketLock {
+private:
+    char padding0[PADDING_BYTES];
+    atomic<int64_t> nextTicket;
+    char padding1[PADDING_BYTES];
+    atomic<int64_t> nowServing;
+    char padding2[PADDING_BYTES];
+public:
+    TicketLock(const int _numThreads = MAX_THREADS) : nextTicket(0), nowServing(0) {}
+    bool tryLock(const int tid) {
+        int64_t serving = nowServing.load(memory_order_acquire);
+        int64_t expected = serving;
+        return nextTicket.compare_exchange_strong(expected, serving+1);
+    }
+    void lock(const int tid) {
+        int64_t myTicket = nextTicket.fetch_add(1);
+        while (true) {
+            int64_t serving = nowServing.load(memory_order_acquire);
+            if (serving == myTicket) return;
+            // back off in proportion to our distance from the front of the queue
+            spinPause(32 * (myTicket - serving));
+        }
+    }
+    void unlock(const int tid) {
+        nowServing.store(nowServing.load(memory_order_relaxed) + 1, memory_order_release);
+    }
+    bool isHeld() {
+        return nextTicket.load(memory_order_relaxed) != nowServing.load(memory_order_relaxed);
+    }
+};
+
+class MCSLock {
+private:
+    struct QNode {
+        atomic<QNode *> next;
+        atomic<bool> locked;
+        char padding[PADDING_BYTES - sizeof(atomic<QNode *>) - sizeof(atomic<bool>)];
+    };
+
+    char padding0[PADDING_BYTES];
+    atomic<QNode *> tail;
+    char padding1[PADDING_BYTES];
+    QNode qnodes[MAX_THREADS]; // one per thread (a thread holds at most one MCSLock at a time per instance)
+    char padding2[PADDING_BYTES];
+public:
+    MCSLock(const int _numThreads = MAX_THREADS) : tail(nullptr) {
+        for (int i=0;i<MAX_THREADS;++i) {
+            qnodes[i].next = nullptr;
+            qnodes[i].locked = false;
+        }
+    }
+    bool tryLock(const int tid) {
+        QNode * me = &qnodes[tid];
+        me->next.store(nullptr, memory_order_relaxed);
+        me->locked.store(false, memory_order_relaxed);
+        QNode * expected = nullptr;
+        return tail.compare_exchange_strong(expected, me);
+    }
+    void lock(const int tid) {
+        QNode * me = &qnodes[tid];
+        me->next.store(nullptr, memory_order_relaxed);
+        me->locked.store(true, memory_order_relaxed);
+        QNode * pred = tail.exchange(me);
+        if (pred) {
+            pred->next.store(me, memory_order_release);
+            while (me->locked.load(memory_order_acquire)) _mm_pause(); // spin on our own node
+        }
+    }
+    void unlock(const int tid) {
+        QNode * me = &qnodes[tid];
+        QNode * succ = me->next.load(memory_order_acquire);
+        if (!succ) {
+            QNode * expected = me;
+            if (tail.compare_exchange_strong(expected, nullptr)) return; // nobody waiting
+            // a successor swapped itself into tail but hasn't linked itself to us yet
+            while (!(succ = me->next.load(memory_order_acquire))) _mm_pause();
+        }
+        succ->locked.store(false, memory_order_release);
+    }
+    bool isHeld() {
+        return tail.load(memory_order_relaxed) != nullptr;
+    }
+};
+
+class CLHLock {
+private:
+    struct QNode {
+        atomic<bool> locked;
+        char padding[PADDING_BYTES - sizeof(atomic<bool>)];
+    };
+    struct PaddedNodePtrs {
+        QNode * myNode;
+        QNode * myPred;
+        char padding[PADDING_BYTES - 2*sizeof(QNode *)];
+    };
+
+    char padding0[PADDING_BYTES];
+    atomic<QNode *> tail;
+    char padding1[PADDING_BYTES];
+    QNode nodes[MAX_THREADS+1];       // nodes migrate between threads: on unlock we take our predecessor's node
+    PaddedNodePtrs perThread[MAX_THREADS];
+    char padding2[PADDING_BYTES];
+public:
+    CLHLock(const int _numThreads = MAX_THREADS) {
+        for (int i=0;i<MAX_THREADS+1;++i) nodes[i].locked = false;
+        for (int i=0;i<MAX_THREADS;++i) {
+            perThread[i].myNode = &nodes[i];
+            perThread[i].myPred = nullptr;
+        }
+        tail = &nodes[MAX_THREADS];
+    }
+    bool tryLock(const int tid) {
+        QNode * me = perThread[tid].myNode;
+        QNode * t = tail.load(memory_order_acquire);
+        if (t->locked.load(memory_order_acquire)) return false;
+        me->locked.store(true, memory_order_relaxed);
+        if (tail.compare_exchange_strong(t, me)) {
+            perThread[tid].myPred = t;
+            // ABA: t may have been released, recycled by its owner's successor and enqueued again
+            // (locked) before our CAS. then we are queued behind it, and must wait like lock() does
+            while (t->locked.load(memory_order_acquire)) _mm_pause();
+            return true;
+        }
+        me->locked.store(false, memory_order_relaxed);
+        return false;
+    }
+    void lock(const int tid) {
+        QNode * me = perThread[tid].myNode;
+        me->locked.store(true, memory_order_relaxed);
+        QNode * pred = tail.exchange(me);
+        perThread[tid].myPred = pred;
+        while (pred->locked.load(memory_order_acquire)) _mm_pause(); // spin on predecessor's node
+    }
+    void unlock(const int tid) {
+        QNode * me = perThread[tid].myNode;
+        perThread[tid].myNode = perThread[tid].myPred; // recycle predecessor's node (nobody else can be spinning on it)
+        me->locked.store(false, memory_order_release);
+    }
+    bool isHeld() {
+        return tail.load(memory_order_relaxed)->locked.load(memory_order_relaxed);
+    }
+};
+
+class TournamentLock {
+private:
+    // two-thread Peterson lock (one per internal tree node)
+    struct PetersonNode {
+        atomic<bool> flag[2];
+        atomic<int> victim;
+        char padding[PADDING_BYTES - 2*sizeof(atomic<bool>) - sizeof(atomic<int>)];
+
+        bool tryLock(const int side) {
+            flag[side] = true;
+            victim = side;
+            if (flag[1-side] && victim == side) {
+                flag[side] = false; // withdraw
+                return false;
+            }
+            return true;
+        }
+        void lock(const int side) {
+            flag[side] = true;
+            victim = side;
+            while (flag[1-side] && victim == side) _mm_pause();
+        }
+        void unlock(const int side) {
+            flag[side].store(false, memory_order_release);
+        }
+    };
+
+    char padding0[PADDING_BYTES];
+    PetersonNode * nodes;   // heap-ordered: nodes[1] is the root, children of i are 2i and 2i+1
+    int numLeaves;          // thread tid starts at position numLeaves+tid
+    int depth;
+    char padding1[PADDING_BYTES];
+    atomic<int> holders;    // only used to answer isHeld()
+    char padding2[PADDING_BYTES];
+
+public:
+    TournamentLock(const int _numThreads = MAX_THREADS) : holders(0) {
+        numLeaves = 1;
+        depth = 0;
+        while (numLeaves < _numThreads) {
+            numLeaves *= 2;
+            ++depth;
+        }
+        nodes = new PetersonNode[max(numLeaves, 2)];
+        for (int i=0;i<max(numLeaves, 2);++i) {
+            nodes[i].flag[0] = false;
+            nodes[i].flag[1] = false;
+            nodes[i].victim = 0;
+        }
+    }
+    ~TournamentLock() {
+        delete[] nodes;
+    }
+    bool tryLock(const int tid) {
+        int pos = numLeaves + tid;
+        for (int level=0; level<depth; ++level, pos/=2) {
+            if (!nodes[pos/2].tryLock(pos%2)) {
+                // give back the levels below this one (which we acquired from the bottom up)
+                for (int l=level-1; l>=0; --l) {
+                    int p = (numLeaves + tid) >> l;
+                    nodes[p/2].unlock(p%2);
+                }
+                return false;
+            }
+        }
+        holders.store(1, memory_order_relaxed);
+        return true;
+    }
+    void lock(const int tid) {
+        int pos = numLeaves + tid;
+        for (int level=0; level<depth; ++level, pos/=2) {
+            nodes[pos/2].lock(pos%2);
+        }
+        holders.store(1, memory_order_relaxed);
+    }
+    void unlock(const int tid) {
+        holders.store(0, memory_order_relaxed);
+        // release from the root downward: if we released a lower node first, the thread
+        // that wins it would share our flag at the next node up, and our unlock would clear its flag
+        for (int level=depth-1; level>=0; --level) {
+            int pos = (numLeaves + tid) >> level;
+            nodes[pos/2].unlock(pos%2);
+        }
+    }
+    bool isHeld() {
+        return holders.load(memory_order_relaxed) != 0;
+    }
+};
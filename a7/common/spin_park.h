@@ -0,0 +1,127 @@
+/**
+ * Spin-then-park waiting, shared by the util.h headers of a2, a4 and a7
+ * (a2 and a4 include it by relative path, as a4 does with ../a5/recordmgr).
+ *
+ * SpinThenPark    for busy-wait loops whose condition nobody signals
+ * ParkingWord     an atomic word that waiters can sleep on (with a futex),
+ *                 and that every update wakes them from
+ */
+
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+#include <immintrin.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef SPIN_PARK_SPINS
+#define SPIN_PARK_SPINS 12              // rounds of exponential backoff (1, 2, 4, ... pause instructions) before parking
+#endif
+
+#ifndef SPIN_PARK_TIMEOUT_NS
+#define SPIN_PARK_TIMEOUT_NS 100000     // longest a parked thread sleeps before re-checking its condition
+#endif
+
+// benchmarks can turn parking off (so waiters spin forever) to measure its effect
+static bool spinParkEnabled = true;
+
+static inline long futexWait(volatile void * addr, int expected, int64_t timeoutNs) {
+    timespec ts;
+    ts.tv_sec = timeoutNs / 1000000000;
+    ts.tv_nsec = timeoutNs % 1000000000;
+    return syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, &ts, NULL, 0);
+}
+
+static inline long futexWakeAll(volatile void * addr) {
+    return syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+// Spin-then-park helper for busy-wait loops:
+//     SpinThenPark w; while (!condition) w.wait();
+// The first SPIN_PARK_SPINS calls spin with exponential pause backoff.
+// After that, each call gives up the core for up to SPIN_PARK_TIMEOUT_NS.
+// (Use ParkingWord when the waker can tell us exactly when to wake up.)
+class SpinThenPark {
+private:
+    int rounds = 0;
+public:
+    // returns false once we have spun long enough that the caller should park
+    bool spin() {
+        if (rounds < SPIN_PARK_SPINS || !spinParkEnabled) {
+            int pauses = 1 << std::min(rounds, 10);
+            for (int i=0;i<pauses;++i) _mm_pause();
+            ++rounds;
+            return true;
+        }
+        return false;
+    }
+    void park() {
+        timespec ts;
+        ts.tv_sec = 0;
+        ts.tv_nsec = SPIN_PARK_TIMEOUT_NS;
+        nanosleep(&ts, NULL);
+    }
+    void wait() {
+        if (!spin()) park();
+    }
+};
+
+// A 32-bit atomic word that threads can wait on: waiters spin briefly and then
+// sleep on a futex, and every update wakes parked waiters (but only makes a
+// system call if someone is actually parked).
+class ParkingWord {
+private:
+    std::atomic<int> v;
+    std::atomic<int> numParked;
+
+    void park(int cur) {
+        numParked.fetch_add(1);
+        futexWait(&v, cur, SPIN_PARK_TIMEOUT_NS); // returns immediately if v != cur
+        numParked.fetch_sub(1);
+    }
+public:
+    ParkingWord(int _v = 0) : v(_v), numParked(0) {}
+    int load() {
+        return v.load();
+    }
+    void store(int x) {
+        v.store(x);
+        wake();
+    }
+    int fetch_add(int x) {
+        int result = v.fetch_add(x);
+        wake();
+        return result;
+    }
+    void wake() {
+        // seq_cst: either we see the waiter's increment, or the waiter sees our update
+        if (numParked.load() > 0) futexWakeAll(&v);
+    }
+    // wait until pred(current value) is true
+    template <class Pred>
+    void waitUntil(Pred pred) {
+        SpinThenPark waiter;
+        int cur;
+        while (!pred(cur = v.load())) {
+            if (waiter.spin()) continue;
+            park(cur);
+        }
+    }
+    // wait while cond() is true, where every thread that can make cond() false
+    // updates this word afterwards (e.g., a lock whose releases are counted here)
+    template <class Cond>
+    void waitWhile(Cond cond) {
+        SpinThenPark waiter;
+        while (true) {
+            int cur = v.load(); // read before cond(), so an update after cond() makes park return immediately
+            if (!cond()) return;
+            if (waiter.spin()) continue;
+            park(cur);
+        }
+    }
+};
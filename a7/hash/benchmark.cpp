@@ -16,6 +16,12 @@
 
 using namespace std;
 
+int batchSize = 1; // keys per insertBatch/eraseBatch call (1 means single-key operations)
+
+#ifndef MAX_BATCH_SIZE
+#define MAX_BATCH_SIZE 1024
+#endif
+
 template <class DataStructureType>
 struct globals_t {
     PaddedRandom rngs[MAX_THREADS];
@@ -26,9 +32,9 @@ struct globals_t {
     volatile char padding2[PADDING_BYTES];
     volatile bool done;
     volatile char padding3[PADDING_BYTES];
-    volatile bool start;        // used for a custom barrier implementation (should threads start yet?)
+    ParkingWord start;          // used for a custom barrier implementation (should threads start yet?)
     volatile char padding4[PADDING_BYTES];
-    atomic_int running;         // used for a custom barrier implementation (how many threads are waiting?)
+    ParkingWord running;        // used for a custom barrier implementation (how many threads are waiting?)
     volatile char padding5[PADDING_BYTES];
     DataStructureType * ds;
     debugCounter numTotalOps;   // already has padding built in at the beginning and end
@@ -45,8 +51,6 @@ struct globals_t {
         }
         elapsedMillis = 0;
         done = false;
-        start = false;
-        running = 0;
         ds = _ds;
         millisToRun = _millisToRun;
         totalThreads = _totalThreads;
@@ -58,6 +62,32 @@ struct globals_t {
     }
 } __attribute__((aligned(PADDING_BYTES)));
 
+// batchSize random keys in [1, keyRangeSize], each of which is inserted or erased (with equal probability).
+// the inserts go in one insertBatch call, then the erases in one eraseBatch call.
+template <class DataStructureType>
+void doRandomBatch(globals_t<DataStructureType> * g, const int tid) {
+    int insertKeys[MAX_BATCH_SIZE] {};
+    int eraseKeys[MAX_BATCH_SIZE] {};
+    bool results[MAX_BATCH_SIZE];
+    int numInserts = 0;
+    int numErases = 0;
+    for (int i=0;i<batchSize;++i) {
+        double operationType = g->rngs[tid].nextNatural() / (double) numeric_limits<unsigned int>::max();
+        int key = 1 + (g->rngs[tid].nextNatural() % g->keyRangeSize);
+        if (operationType < 0.5) insertKeys[numInserts++] = key;
+        else eraseKeys[numErases++] = key;
+    }
+
+    g->ds->insertBatch(tid, insertKeys, numInserts, results);
+    for (int i=0;i<numInserts;++i) {
+        if (results[i]) g->keyChecksum.add(tid, insertKeys[i]);
+    }
+    g->ds->eraseBatch(tid, eraseKeys, numErases, results);
+    for (int i=0;i<numErases;++i) {
+        if (results[i]) g->keyChecksum.add(tid, -eraseKeys[i]);
+    }
+}
+
 void printUpdatedThroughput(auto g, int64_t elapsedNow) {
     auto opsNow = g->numTotalOps.getTotal();
     cout<<elapsedNow <<"ms: "<<opsNow<<" total_ops"<<endl;
@@ -84,7 +114,7 @@ void runExperiment(int keyRangeSize, int tableSize, int millisToRun, int totalTh
 
                 // BARRIER WAIT
                 g->running.fetch_add(1);
-                while (!g->start) { TRACE TPRINT("waiting to start"); } // wait to start
+                g->start.waitUntil([](int v) { return v; }); // wait to start (spin, then park, so oversubscribed runs don't burn the cores of threads that are still being created)
 
                 for (int cnt=0; !g->done; ++cnt) {
                     if ((cnt % OPS_BETWEEN_TIME_CHECKS) == 0                    // once every X operations
@@ -95,6 +125,12 @@ void runExperiment(int keyRangeSize, int tableSize, int millisToRun, int totalTh
 
                     VERBOSE if (cnt&&((cnt % 1000000) == 0)) TPRINT("op# "<<cnt);
 
+                    if (batchSize > 1) {
+                        doRandomBatch(g, tid);
+                        g->numTotalOps.add(tid, batchSize);
+                        continue;
+                    }
+
                     // flip a coin to decide: insert or erase?
                     // generate a random double in [0, 1]
                     double operationType = g->rngs[tid].nextNatural() / (double) numeric_limits<unsigned int>::max();
@@ -120,23 +156,20 @@ void runExperiment(int keyRangeSize, int tableSize, int millisToRun, int totalTh
         });
     }
 
-    while (g->running < g->totalThreads) {
-        TRACE printf("main thread: waiting for threads to START running=%d\n", g->running.load());
-    } // wait for all threads to be ready
+    g->running.waitUntil([&](int v) { return v >= g->totalThreads; }); // wait for all threads to be ready
 
     printf("main thread: starting timer...\n");
     g->timer.startTimer();
-    __asm__ __volatile__ ("" ::: "memory"); // prevent compiler from reordering "start = true;" before the timer start; this is mostly paranoia, since start is volatile, and nothing should be reordered around volatile reads/writes (by the *compiler*)
+    __asm__ __volatile__ ("" ::: "memory"); // prevent compiler from reordering the release of the barrier before the timer start (mostly paranoia)
 
-    g->start = true; // release all threads from the barrier, so they can work
-    __sync_synchronize(); // flush store buffer so other threads can see the write to g->start immediately (so they start working ASAP)
+    g->start.store(1); // release all threads from the barrier, so they can work (seq_cst store, and it wakes any parked threads)
 
 
     // wait for all threads to stop working,
     // and print throughput update every 1s
 
     int64_t lastTime = 0;
-    while (g->running > 0) {
+    while (g->running.load() > 0) {
         // sleep for 0.1s
         timespec time_to_sleep;
         time_to_sleep.tv_sec = 0;
@@ -199,6 +232,45 @@ void runExperiment(int keyRangeSize, int tableSize, int millisToRun, int totalTh
     delete g;
 }
 
+// run DataStructureType with the capacity policy named by capacityPolicy (see util.h)
+template <template <class> class DataStructureType>
+void runExperimentWithCapacityPolicy(const char * capacityPolicy, int keyRangeSize, int tableSize, int millisToRun, int totalThreads) {
+    if (!strcmp(capacityPolicy, ModuloCapacity::name())) {
+        runExperiment<DataStructureType<ModuloCapacity>>(keyRangeSize, tableSize, millisToRun, totalThreads);
+    } else if (!strcmp(capacityPolicy, PowerOfTwoCapacity::name())) {
+        runExperiment<DataStructureType<PowerOfTwoCapacity>>(keyRangeSize, tableSize, millisToRun, totalThreads);
+    } else if (!strcmp(capacityPolicy, FastRangeCapacity::name())) {
+        runExperiment<DataStructureType<FastRangeCapacity>>(keyRangeSize, tableSize, millisToRun, totalThreads);
+    } else {
+        cout<<"Bad capacity policy: "<<capacityPolicy<<endl;
+        exit(1);
+    }
+}
+
+// DataStructureType with its hash policy fixed to HashPolicy (so it can be passed to runExperimentWithCapacityPolicy)
+template <template <class, class> class DataStructureType, class HashPolicy>
+struct withHashPolicy {
+    template <class CapacityPolicy>
+    using type = DataStructureType<CapacityPolicy, HashPolicy>;
+};
+
+// run DataStructureType with the hash and capacity policies named by hashPolicy and capacityPolicy (see util.h)
+template <template <class, class> class DataStructureType>
+void runExperimentWithHashPolicy(const char * hashPolicy, const char * capacityPolicy, int keyRangeSize, int tableSize, int millisToRun, int totalThreads) {
+    if (!strcmp(hashPolicy, Murmur3Hash::name())) {
+        runExperimentWithCapacityPolicy<withHashPolicy<DataStructureType, Murmur3Hash>::template type>(capacityPolicy, keyRangeSize, tableSize, millisToRun, totalThreads);
+    } else if (!strcmp(hashPolicy, CRC32CHash::name())) {
+        runExperimentWithCapacityPolicy<withHashPolicy<DataStructureType, CRC32CHash>::template type>(capacityPolicy, keyRangeSize, tableSize, millisToRun, totalThreads);
+    } else if (!strcmp(hashPolicy, MultiplyShiftHash::name())) {
+        runExperimentWithCapacityPolicy<withHashPolicy<DataStructureType, MultiplyShiftHash>::template type>(capacityPolicy, keyRangeSize, tableSize, millisToRun, totalThreads);
+    } else if (!strcmp(hashPolicy, IdentityHash::name())) {
+        runExperimentWithCapacityPolicy<withHashPolicy<DataStructureType, IdentityHash>::template type>(capacityPolicy, keyRangeSize, tableSize, millisToRun, totalThreads);
+    } else {
+        cout<<"Bad hash policy: "<<hashPolicy<<endl;
+        exit(1);
+    }
+}
+
 int main(int argc, char** argv) {
     if (argc == 1) {
         cout<<"USAGE: "<<argv[0]<<" [options]"<<endl;
@@ -207,6 +279,11 @@ int main(int argc, char** argv) {
         cout<<"    -m  [int]      [m]illiseconds to run"<<endl;
         cout<<"    -sR [int]      size of the key [R]ange that random keys will be drawn from (i.e., range [1, s])"<<endl;
         cout<<"    -t  [int]      number of [t]hreads that will perform inserts and deletes"<<endl;
+        cout<<"    -os [int]      [o]ver[s]ubscribe: run [int] threads per online logical processor (overrides -t)"<<endl;
+        cout<<"    -spin          never park waiting threads (pure spinning), to compare against spin-then-park"<<endl;
+        cout<<"    -b  [int]      [b]atch size, i.e., keys per insertBatch/eraseBatch call (at most "<<MAX_BATCH_SIZE<<") [default 1: no batching]"<<endl;
+        cout<<"    -hf [string]   [h]ash [f]unction policy in { murmur3, crc32c, multshift, identity } [default murmur3]"<<endl;
+        cout<<"    -cp [string]   [c]apacity [p]olicy in { mod, pow2, fastrange } mapping hashes to slots [default mod] (pow2 rounds sizes up)"<<endl;
         cout<<endl;
         cout<<"Example: "<<argv[0]<<" -m 10000 -sT 1000 -sR 1000000 -t 16"<<endl;
         return 1;
@@ -216,6 +293,9 @@ int main(int argc, char** argv) {
     int tableSize = 0;
     int keyRangeSize = 0;
     int totalThreads = 0;
+    int oversubscription = 0;
+    const char * capacityPolicy = ModuloCapacity::name();
+    const char * hashPolicy = Murmur3Hash::name();
 
     // read command line args
     for (int i=1;i<argc;++i) {
@@ -227,12 +307,26 @@ int main(int argc, char** argv) {
             totalThreads = atoi(argv[++i]);
         } else if (strcmp(argv[i], "-m") == 0) {
             millisToRun = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-os") == 0) {
+            oversubscription = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-spin") == 0) {
+            spinParkEnabled = false;
+        } else if (strcmp(argv[i], "-b") == 0) {
+            batchSize = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-hf") == 0) {
+            hashPolicy = argv[++i];
+        } else if (strcmp(argv[i], "-cp") == 0) {
+            capacityPolicy = argv[++i];
         } else {
             cout<<"bad arguments"<<endl;
             exit(1);
         }
     }
 
+    if (oversubscription > 0) {
+        totalThreads = oversubscription * sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
     // print command and args for debugging
     std::cout<<"Cmd:";
     for (int i=0;i<argc;++i) {
@@ -246,6 +340,10 @@ int main(int argc, char** argv) {
     PRINT(keyRangeSize);
     PRINT(tableSize);
     PRINT(totalThreads);
+    PRINT(spinParkEnabled);
+    PRINT(capacityPolicy);
+    PRINT(hashPolicy);
+    PRINT(batchSize);
     cout<<endl;
 
     // check for too large thread count
@@ -254,7 +352,12 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    runExperiment<TLEHashTableExpand>(keyRangeSize, tableSize, millisToRun, totalThreads);
+    if (batchSize < 1 || batchSize > MAX_BATCH_SIZE) {
+        std::cout<<"ERROR: batchSize="<<batchSize<<" must be in [1, MAX_BATCH_SIZE="<<MAX_BATCH_SIZE<<"]"<<std::endl;
+        return 1;
+    }
+
+    runExperimentWithHashPolicy<TLEHashTableExpand>(hashPolicy, capacityPolicy, keyRangeSize, tableSize, millisToRun, totalThreads);
 
     return 0;
 }
@@ -1,10 +1,16 @@
 #pragma once
 #include <immintrin.h>
 #include <atomic>
+#include <vector>
 #include "util.h"
 #include "tle.h"
 using namespace std;
 
+#ifndef TOMBSTONE_PURGE_FRACTION
+#define TOMBSTONE_PURGE_FRACTION 8         // purge tombstones once more than capacity/TOMBSTONE_PURGE_FRACTION slots hold them
+#endif
+
+template <class CapacityPolicy = ModuloCapacity, class HashPolicy = Murmur3Hash>
 class TLEHashTableExpand {
 private:
     enum {
@@ -18,29 +24,45 @@ private:
     volatile int * data;
     volatile int * old;
     int64_t capacity;
+    CapacityPolicy slots;                   // maps hashes to slots in data (rebuilt when capacity changes)
     int64_t oldCapacity;
     counter * approxInserts;                // only create ONCE in the constructor, then use set() to reset its value if needed
     counter * approxDeletes;                // only create ONCE in the constructor, then use set() to reset its value if needed
     char padding1[PADDING_BYTES];
 
     bool isExpandNeeded(const int tid, int64_t probeCount);
+    bool isPurgeNeeded(const int tid, int64_t probeCount);
     void expand(const int tid);
+    void purgeTombstones(const int tid);
     int64_t getAccurateSize();
     void migrateInsert(const int & key);
+    // the operations, for a key whose hash is h
+    bool insertHashed(const int tid, const int key, const uint32_t h);
+    bool eraseHashed(const int tid, const int key, const uint32_t h);
+    bool containsHashed(const int tid, const int key, const uint32_t h);
+    void probeBatch(const int tid, const int * keys, const uint32_t * hashes, const int n, bool * out);
+    template <class Op>
+    void runBatch(const int tid, const int * keys, const int n, bool * out, Op op);
 
 public:
     TLEHashTableExpand(const int _numThreads, const int64_t _capacity);
     ~TLEHashTableExpand();
     bool insertIfAbsent(const int tid, const int & key);
     bool erase(const int tid, const int & key);
+    bool contains(const int tid, const int & key);
+    void insertBatch(const int tid, const int * keys, const int n, bool * out);
+    void eraseBatch(const int tid, const int * keys, const int n, bool * out);
+    void containsBatch(const int tid, const int * keys, const int n, bool * out);
     long getSumOfKeys();
     void printDebuggingDetails();
 };
 
 // _capacity is the INITIAL size of the hash table (maximum number of elements it can contain WITHOUT expansion)
-TLEHashTableExpand::TLEHashTableExpand(const int _numThreads, const int64_t _capacity) {
+template <class CapacityPolicy, class HashPolicy>
+TLEHashTableExpand<CapacityPolicy, HashPolicy>::TLEHashTableExpand(const int _numThreads, const int64_t _capacity) {
     numThreads = _numThreads;
-    capacity = _capacity;
+    capacity = CapacityPolicy::roundUp(_capacity);
+    slots = CapacityPolicy(capacity);
     data = new volatile int[capacity];
     for (int64_t i=0;i<capacity;++i) data[i] = EMPTY;
     approxInserts = new counter(numThreads);
@@ -50,37 +72,95 @@ TLEHashTableExpand::TLEHashTableExpand(const int _numThreads, const int64_t _cap
     debugTimer.startTimer();
 }
 
-TLEHashTableExpand::~TLEHashTableExpand() {
+template <class CapacityPolicy, class HashPolicy>
+TLEHashTableExpand<CapacityPolicy, HashPolicy>::~TLEHashTableExpand() {
     delete[] data;
     delete[] old;
     delete approxInserts;
     delete approxDeletes;
 }
 
-int64_t TLEHashTableExpand::getAccurateSize() {
+template <class CapacityPolicy, class HashPolicy>
+int64_t TLEHashTableExpand<CapacityPolicy, HashPolicy>::getAccurateSize() {
     int64_t accurateInserts = approxInserts->getAccurate();
     int64_t accurateDeletes = approxDeletes->getAccurate();
     return accurateInserts - accurateDeletes;
 }
 
-bool TLEHashTableExpand::isExpandNeeded(const int tid, int64_t probeCount) {
+template <class CapacityPolicy, class HashPolicy>
+bool TLEHashTableExpand<CapacityPolicy, HashPolicy>::isExpandNeeded(const int tid, int64_t probeCount) {
     return ((approxInserts->get() > capacity/3) ||
             (probeCount > 100 && approxInserts->getAccurate() > capacity/3));
 }
 
-void TLEHashTableExpand::expand(const int tid) {
+// approxDeletes counts the tombstones created since the last expansion/purge
+template <class CapacityPolicy, class HashPolicy>
+bool TLEHashTableExpand<CapacityPolicy, HashPolicy>::isPurgeNeeded(const int tid, int64_t probeCount) {
+    return ((approxDeletes->get() > capacity/TOMBSTONE_PURGE_FRACTION) ||
+            (probeCount > 100 && approxDeletes->getAccurate() > capacity/TOMBSTONE_PURGE_FRACTION));
+}
+
+// rehash the table in place (same capacity), turning every tombstone back into an EMPTY slot.
+// must be called while holding the global (fallback) lock.
+template <class CapacityPolicy, class HashPolicy>
+void TLEHashTableExpand<CapacityPolicy, HashPolicy>::purgeTombstones(const int tid) {
+    int64_t purgeStartTime = debugTimer.getElapsedMillis();
+    int64_t accurateSize = getAccurateSize();
+
+    // keys that have been placed in their final slot (we only need a bit per slot, not a second table)
+    vector<uint64_t> placed((capacity + 63) / 64, 0);
+    auto isPlaced = [&](int64_t i) { return (placed[i >> 6] >> (i & 63)) & 1; };
+    auto setPlaced = [&](int64_t i) { placed[i >> 6] |= (1ULL << (i & 63)); };
+
+    #pragma omp parallel for
+    for (int64_t i=0;i<capacity;++i) {
+        if (data[i] == TOMBSTONE) data[i] = EMPTY;
+    }
+    // re-place every key at the first slot on its probe sequence that is not already
+    // holding a placed key. if that slot holds a key that is not placed yet, swap the
+    // two keys and continue with the displaced key. placed keys never move, so every slot
+    // before a placed key on its probe sequence holds another placed key (i.e., never EMPTY).
+    for (int64_t i=0;i<capacity;++i) {
+        int key;
+        while ((key = data[i]) != EMPTY && !isPlaced(i)) {
+            int64_t target = slots.home(HashPolicy::hash(key));
+            while (target != i && isPlaced(target)) target = slots.next(target);
+            if (target != i) {
+                data[i] = data[target]; // EMPTY, or a key still to be placed
+                data[target] = key;
+            }
+            setPlaced(target);
+        }
+    }
+
+    approxInserts->set(accurateSize);
+    approxDeletes->set(0);
+
+    auto purgeEndTime = debugTimer.getElapsedMillis();
+    printf("tid=%d purge at_ms=%ld duration_ms=%ld capacity=%ld size=%ld\n", tid, purgeStartTime, (purgeEndTime - purgeStartTime), capacity, accurateSize);
+}
+
+template <class CapacityPolicy, class HashPolicy>
+void TLEHashTableExpand<CapacityPolicy, HashPolicy>::expand(const int tid) {
     int64_t expansionStartTime = debugTimer.getElapsedMillis();
 
     // EXPANSION CODE HERE :)
     int64_t accurateSize = getAccurateSize();
 
+    // if the table would not grow, most of its occupied slots are tombstones: reclaim them in place
+    if (max(accurateSize, int64_t(1)) * 8 <= capacity) {
+        purgeTombstones(tid);
+        return;
+    }
+
     delete[] old;
     old = data;
 
     TRACE {cout << "Expanding" << endl;}
     TRACE {PRINT(capacity); }
     oldCapacity = capacity;
-    capacity = max(max(accurateSize, int64_t(1)) * 8, oldCapacity);
+    capacity = CapacityPolicy::roundUp(max(max(accurateSize, int64_t(1)) * 8, oldCapacity));
+    slots = CapacityPolicy(capacity);
     TRACE {PRINT(capacity); }
 
     data = new volatile int [capacity];
@@ -103,11 +183,12 @@ void TLEHashTableExpand::expand(const int tid) {
     printf("tid=%d expansion at_ms=%ld duration_ms=%ld oldCapacity=%ld newCapacity=%ld\n", tid, expansionStartTime, (expansionEndTime - expansionStartTime), oldCapacity, capacity);
 }
 
-void TLEHashTableExpand::migrateInsert(const int & key){
-    int64_t h = murmur3(key);
+template <class CapacityPolicy, class HashPolicy>
+void TLEHashTableExpand<CapacityPolicy, HashPolicy>::migrateInsert(const int & key){
+    int64_t h = HashPolicy::hash(key);
 
-    for(int64_t probe=0; probe < capacity; ++probe){
-        int64_t index = (h+probe) % capacity;
+    int64_t index = slots.home(h);
+    for(int64_t probe=0; probe < capacity; ++probe, index = slots.next(index)){
         int found = data[index];
 
         if (found == EMPTY){
@@ -126,25 +207,34 @@ void TLEHashTableExpand::migrateInsert(const int & key){
 }
 
 // semantics: try to insert key. return true if successful (if key doesn't already exist), and false otherwise
-bool TLEHashTableExpand::insertIfAbsent(const int tid, const int & key) {
-    int64_t h = murmur3(key);
+template <class CapacityPolicy, class HashPolicy>
+bool TLEHashTableExpand<CapacityPolicy, HashPolicy>::insertIfAbsent(const int tid, const int & key) {
+    return insertHashed(tid, key, HashPolicy::hash(key));
+}
+
+template <class CapacityPolicy, class HashPolicy>
+bool TLEHashTableExpand<CapacityPolicy, HashPolicy>::insertHashed(const int tid, const int key, const uint32_t h) {
 restart:
 {
     TLEGuard guard = TLEGuard(tid); // Must keep the guard out here in case capacity changes
-    for (int64_t probeCount = 0; probeCount < capacity; ++probeCount){
+    int64_t index = slots.home(h);
+    for (int64_t probeCount = 0; probeCount < capacity; ++probeCount, index = slots.next(index)){
         
-        if (isExpandNeeded(tid, probeCount)){
+        if (isPurgeNeeded(tid, probeCount) || isExpandNeeded(tid, probeCount)){
             guard.explicit_fallback();
             // Not sure if this is required, but should be fast if we have the lock
+            if (isPurgeNeeded(tid, probeCount)){
+                purgeTombstones(tid);
+                goto restart;
+            }
             if (isExpandNeeded(tid, probeCount)){
                 expand(tid);
                 goto restart;
             }
-            
+
         }
 
         // Look at next value
-        int64_t index = (h+probeCount) % capacity;
         int found = data[index];
 
         // Attempt the insert
@@ -166,13 +256,17 @@ restart:
 }
 
 // semantics: try to erase key. return true if successful, and false otherwise
-bool TLEHashTableExpand::erase(const int tid, const int & key) {
-    int64_t h = murmur3(key);
+template <class CapacityPolicy, class HashPolicy>
+bool TLEHashTableExpand<CapacityPolicy, HashPolicy>::erase(const int tid, const int & key) {
+    return eraseHashed(tid, key, HashPolicy::hash(key));
+}
 
+template <class CapacityPolicy, class HashPolicy>
+bool TLEHashTableExpand<CapacityPolicy, HashPolicy>::eraseHashed(const int tid, const int key, const uint32_t h) {
     {
         TLEGuard guard = TLEGuard(tid);
-        for(int64_t i=0; i < capacity; ++i){
-            int64_t index = (h+i) % capacity;
+        int64_t index = slots.home(h);
+        for(int64_t i=0; i < capacity; ++i, index = slots.next(index)){
             int found = data[index];
 
             if (found == key){
@@ -192,8 +286,105 @@ bool TLEHashTableExpand::erase(const int tid, const int & key) {
 
 }
 
+// semantics: return true if key is in the set, and false otherwise.
+// a read-only critical section, so it commits without writing anything (and never falls back to the lock to expand or purge)
+template <class CapacityPolicy, class HashPolicy>
+bool TLEHashTableExpand<CapacityPolicy, HashPolicy>::contains(const int tid, const int & key) {
+    return containsHashed(tid, key, HashPolicy::hash(key));
+}
+
+template <class CapacityPolicy, class HashPolicy>
+bool TLEHashTableExpand<CapacityPolicy, HashPolicy>::containsHashed(const int tid, const int key, const uint32_t h) {
+    TLEGuard guard = TLEGuard(tid);
+    int64_t index = slots.home(h);
+    for (int64_t i=0; i < capacity; ++i, index = slots.next(index)){
+        int found = data[index];
+        if (found == key || found == EMPTY){
+            guard.explicit_commit();
+            return (found == key);
+        }
+    }
+    guard.explicit_commit();
+    return false;
+}
+
+/**
+ * Batched operations, in groups of BATCH_INFLIGHT keys. Each group first walks the probe sequences of all of
+ * its keys in ONE read-only critical section, interleaved as in AlgorithmC's batches (asynchronous memory access
+ * chaining): each key has a lane that remembers its current slot, and we prefetch that slot and step every other
+ * lane before coming back to it, so the misses along the probe sequences overlap one another instead of being
+ * taken one at a time. A lane stops at its key or at an EMPTY slot, which is exactly the answer to contains.
+ * Inserts and erases then run in their own critical sections, which find the slots they look at in the cache.
+ * out[i] gets the result of the operation on keys[i].
+ */
+template <class CapacityPolicy, class HashPolicy>
+void TLEHashTableExpand<CapacityPolicy, HashPolicy>::probeBatch(const int tid, const int * keys, const uint32_t * hashes, const int n, bool * out) {
+    struct lane {
+        int64_t index;
+        int64_t probes;
+        bool done;
+    } lanes[BATCH_INFLIGHT];
+    TLEGuard guard = TLEGuard(tid);
+    for (int i = 0; i < n; ++i) {
+        lanes[i].index = slots.home(hashes[i]);
+        lanes[i].probes = 0;
+        lanes[i].done = false;
+        __builtin_prefetch((const void *) &data[lanes[i].index]);
+    }
+    int active = n;
+    while (active > 0) {
+        for (int i = 0; i < n; ++i) {
+            lane & l = lanes[i];
+            if (l.done) continue;
+            int found = data[l.index];
+            if (found == keys[i] || found == EMPTY || ++l.probes == capacity) {
+                out[i] = (found == keys[i]);
+                l.done = true;
+                --active;
+            } else {
+                l.index = slots.next(l.index);
+                __builtin_prefetch((const void *) &data[l.index]);
+            }
+        }
+    }
+    guard.explicit_commit();
+}
+
+template <class CapacityPolicy, class HashPolicy>
+template <class Op>
+void TLEHashTableExpand<CapacityPolicy, HashPolicy>::runBatch(const int tid, const int * keys, const int n, bool * out, Op op) {
+    uint32_t hashes[BATCH_INFLIGHT];
+    for (int start = 0; start < n; start += BATCH_INFLIGHT) {
+        int size = min(n - start, BATCH_INFLIGHT);
+        for (int i = 0; i < size; ++i) hashes[i] = HashPolicy::hash(keys[start + i]);
+        probeBatch(tid, keys + start, hashes, size, out + start); // brings the group's slots into the cache
+        for (int i = 0; i < size; ++i) out[start + i] = (this->*op)(tid, keys[start + i], hashes[i]);
+    }
+}
+
+template <class CapacityPolicy, class HashPolicy>
+void TLEHashTableExpand<CapacityPolicy, HashPolicy>::insertBatch(const int tid, const int * keys, const int n, bool * out) {
+    runBatch(tid, keys, n, out, &TLEHashTableExpand::insertHashed);
+}
+
+template <class CapacityPolicy, class HashPolicy>
+void TLEHashTableExpand<CapacityPolicy, HashPolicy>::eraseBatch(const int tid, const int * keys, const int n, bool * out) {
+    runBatch(tid, keys, n, out, &TLEHashTableExpand::eraseHashed);
+}
+
+template <class CapacityPolicy, class HashPolicy>
+void TLEHashTableExpand<CapacityPolicy, HashPolicy>::containsBatch(const int tid, const int * keys, const int n, bool * out) {
+    uint32_t hashes[BATCH_INFLIGHT];
+    for (int start = 0; start < n; start += BATCH_INFLIGHT) {
+        int size = min(n - start, BATCH_INFLIGHT);
+        for (int i = 0; i < size; ++i) hashes[i] = HashPolicy::hash(keys[start + i]);
+        probeBatch(tid, keys + start, hashes, size, out + start);
+    }
+}
+
 // semantics: return the sum of all KEYS in the set
-int64_t TLEHashTableExpand::getSumOfKeys() {
+template <class CapacityPolicy, class HashPolicy>
+int64_t TLEHashTableExpand<CapacityPolicy, HashPolicy>::getSumOfKeys() {
     int64_t sum = 0;
     #pragma omp parallel for reduction(+: sum)
     for (int64_t i=0;i<capacity;i++) {
@@ -204,4 +395,5 @@ int64_t TLEHashTableExpand::getSumOfKeys() {
     return sum;
 }
 
-void TLEHashTableExpand::printDebuggingDetails() {}
+template <class CapacityPolicy, class HashPolicy>
+void TLEHashTableExpand<CapacityPolicy, HashPolicy>::printDebuggingDetails() {}
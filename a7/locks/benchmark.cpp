@@ -0,0 +1,236 @@
+/**
+ * Lock benchmark: threads repeatedly acquire a lock, perform a critical
+ * section of configurable length, release the lock, and then perform some
+ * (configurable) non-critical work. Sweeps thread counts and critical
+ * section lengths for each lock in locks.h.
+ */
+
+#include <thread>
+#include <cstdlib>
+#include <atomic>
+#include <string>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "util.h"
+#include "locks.h"
+#include "cohort_lock.h"
+#include "binding.h"
+
+using namespace std;
+
+#define CS_CACHE_LINES 16 // the critical section writes round-robin to this many shared cache lines
+
+template <class LockType>
+struct globals_t {
+    volatile char padding0[PADDING_BYTES];
+    ElapsedTimer timer;
+    volatile char padding1[PADDING_BYTES];
+    volatile bool done;
+    volatile char padding2[PADDING_BYTES];
+    ParkingWord start;          // used for a custom barrier implementation (should threads start yet?)
+    volatile char padding3[PADDING_BYTES];
+    ParkingWord running;        // used for a custom barrier implementation (how many threads are waiting?)
+    volatile char padding4[PADDING_BYTES];
+    LockType * lock;
+    volatile char padding5[PADDING_BYTES];
+    PaddedInt64 protectedData[CS_CACHE_LINES]; // only accessed inside the critical section
+    volatile int64_t protectedCount;           // number of critical sections executed (checked against numTotalOps)
+    volatile char padding6[PADDING_BYTES];
+    debugCounter numTotalOps;   // already has padding built in at the beginning and end
+    int millisToRun;
+    int totalThreads;
+    int csLength;
+    int ncsLength;
+    bool useTryLock;            // acquire with tryLock (retrying until it succeeds) instead of lock
+    volatile char padding7[PADDING_BYTES];
+
+    globals_t(int _millisToRun, int _totalThreads, int _csLength, int _ncsLength, bool _useTryLock) {
+        done = false;
+        start.store(0);
+        running.store(0);
+        lock = new LockType(_totalThreads);
+        for (int i=0;i<CS_CACHE_LINES;++i) protectedData[i].v = 0;
+        protectedCount = 0;
+        millisToRun = _millisToRun;
+        totalThreads = _totalThreads;
+        csLength = _csLength;
+        ncsLength = _ncsLength;
+        useTryLock = _useTryLock;
+    }
+    ~globals_t() {
+        delete lock;
+    }
+} __attribute__((aligned(PADDING_BYTES)));
+
+template <class LockType>
+void runTrial(const char * lockName, int millisToRun, int totalThreads, int csLength, int ncsLength, bool useTryLock) {
+    auto g = new globals_t<LockType>(millisToRun, totalThreads, csLength, ncsLength, useTryLock);
+
+    thread * threads[MAX_THREADS];
+    for (int tid=0;tid<g->totalThreads;++tid) {
+        threads[tid] = new thread([&, tid]() {
+            const int OPS_BETWEEN_TIME_CHECKS = 100;
+            binding_bindThread(tid);
+
+            // BARRIER WAIT
+            g->running.fetch_add(1);
+            g->start.waitUntil([](int v) { return v; }); // wait to start (spin, then park)
+
+            for (int cnt=0; !g->done; ++cnt) {
+                if ((cnt % OPS_BETWEEN_TIME_CHECKS) == 0 && g->timer.getElapsedMillis() >= g->millisToRun) {
+                    g->done = true;
+                }
+
+                if (g->useTryLock) {
+                    while (!g->lock->tryLock(tid)) _mm_pause();
+                } else {
+                    g->lock->lock(tid);
+                }
+                for (int i=0;i<g->csLength;++i) {
+                    g->protectedData[i % CS_CACHE_LINES].v = g->protectedData[i % CS_CACHE_LINES].v + 1;
+                }
+                g->protectedCount = g->protectedCount + 1;
+                g->lock->unlock(tid);
+
+                spinPause(g->ncsLength);
+                g->numTotalOps.inc(tid);
+            }
+
+            g->running.fetch_add(-1);
+        });
+    }
+
+    g->running.waitUntil([&](int v) { return v >= g->totalThreads; }); // wait for all threads to be ready
+    g->timer.startTimer();
+    g->start.store(1); // release all threads from the barrier (seq_cst store, and it wakes any parked threads)
+
+    for (int tid=0;tid<g->totalThreads;++tid) {
+        threads[tid]->join();
+        delete threads[tid];
+    }
+    auto elapsedMillis = g->timer.getElapsedMillis();
+
+    auto numTotalOps = g->numTotalOps.getTotal();
+    if (numTotalOps != g->protectedCount) {
+        cout<<"ERROR: mutual exclusion violated for lock="<<lockName<<": "<<numTotalOps<<" critical sections, but protected count is "<<g->protectedCount<<endl;
+        exit(-1);
+    }
+
+    cout<<"lock="<<lockName
+        <<(useTryLock ? " acquire=tryLock" : "")
+        <<" threads="<<totalThreads
+        <<" cs="<<csLength
+        <<" ncs="<<ncsLength
+        <<" acquisitions="<<numTotalOps
+        <<" throughput="<<(long long) (numTotalOps * 1000. / elapsedMillis)
+        <<endl;
+    delete g;
+}
+
+template <class LockType>
+void sweep(const char * lockName, int millisToRun, const vector<int> & threadCounts, const vector<int> & csLengths, int ncsLength, bool useTryLock) {
+    for (int cs : csLengths) {
+        for (int n : threadCounts) {
+            runTrial<LockType>(lockName, millisToRun, n, cs, ncsLength, useTryLock);
+        }
+    }
+}
+
+// parse a comma separated list of ints, e.g., "0,10,100"
+vector<int> parseList(const char * str) {
+    vector<int> result;
+    stringstream ss(str);
+    string token;
+    while (getline(ss, token, ',')) result.push_back(atoi(token.c_str()));
+    return result;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 1) {
+        cout<<"USAGE: "<<argv[0]<<" [options]"<<endl;
+        cout<<"Options:"<<endl;
+        cout<<"    -a   [string]   lock algorithm in { tas, ticket, mcs, clh, tournament, cohort, all } [default all]"<<endl;
+        cout<<"    -m   [int]      [m]illiseconds to run each trial"<<endl;
+        cout<<"    -n   [int]      maximum number of threads; thread counts 1, 2, 4, ..., n are swept"<<endl;
+        cout<<"    -cs  [list]     comma separated critical section lengths (shared cache line writes per acquisition) [default 0,10,100]"<<endl;
+        cout<<"    -ncs [int]      pause instructions executed outside the critical section [default 0]"<<endl;
+        cout<<"    -try            acquire with tryLock, retrying until it succeeds, instead of lock (checks tryLock's mutual exclusion)"<<endl;
+        cout<<"    -pin [pattern]  pin threads to logical processors according to [pattern], e.g., -pin 0-23,48-71,24-47,72-95"<<endl;
+        cout<<endl;
+        cout<<"Example: "<<argv[0]<<" -a all -m 1000 -n 64 -cs 0,10,100 -ncs 100"<<endl;
+        return 1;
+    }
+
+    int millisToRun = -1;
+    int maxThreads = 0;
+    int ncsLength = 0;
+    vector<int> csLengths = {0, 10, 100};
+    const char * alg = "all";
+    bool useTryLock = false;
+
+    // read command line args
+    for (int i=1;i<argc;++i) {
+        if (strcmp(argv[i], "-a") == 0) {
+            alg = argv[++i];
+        } else if (strcmp(argv[i], "-m") == 0) {
+            millisToRun = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-n") == 0) {
+            maxThreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-cs") == 0) {
+            csLengths = parseList(argv[++i]);
+        } else if (strcmp(argv[i], "-ncs") == 0) {
+            ncsLength = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-try") == 0) {
+            useTryLock = true;
+        } else if (strcmp(argv[i], "-pin") == 0) { // e.g., "-pin 1,2,3,8-11,4-7,0"
+            binding_parseCustom(argv[++i]);
+            std::cout<<"parsed custom binding: "<<argv[i]<<std::endl;
+        } else {
+            cout<<"bad arguments"<<endl;
+            exit(1);
+        }
+    }
+
+    // print command and args for debugging
+    std::cout<<"Cmd:";
+    for (int i=0;i<argc;++i) {
+        std::cout<<" "<<argv[i];
+    }
+    std::cout<<std::endl;
+
+    PRINT(MAX_THREADS);
+    PRINT(millisToRun);
+    PRINT(maxThreads);
+    PRINT(ncsLength);
+    PRINT(alg);
+    PRINT(useTryLock);
+    cout<<endl;
+
+    if (maxThreads < 1 || maxThreads >= MAX_THREADS) {
+        std::cout<<"ERROR: maxThreads="<<maxThreads<<" must be in [1, MAX_THREADS="<<MAX_THREADS<<")"<<std::endl;
+        return 1;
+    }
+
+    vector<int> threadCounts;
+    for (int n=1;n<maxThreads;n*=2) threadCounts.push_back(n);
+    threadCounts.push_back(maxThreads);
+
+    binding_configurePolicy(maxThreads);
+    bool all = !strcmp(alg, "all");
+    bool ranAny = false;
+    if (all || !strcmp(alg, "tas"))        { sweep<TTASLock>("tas", millisToRun, threadCounts, csLengths, ncsLength, useTryLock); ranAny = true; }
+    if (all || !strcmp(alg, "ticket"))     { sweep<TicketLock>("ticket", millisToRun, threadCounts, csLengths, ncsLength, useTryLock); ranAny = true; }
+    if (all || !strcmp(alg, "mcs"))        { sweep<MCSLock>("mcs", millisToRun, threadCounts, csLengths, ncsLength, useTryLock); ranAny = true; }
+    if (all || !strcmp(alg, "clh"))        { sweep<CLHLock>("clh", millisToRun, threadCounts, csLengths, ncsLength, useTryLock); ranAny = true; }
+    if (all || !strcmp(alg, "tournament")) { sweep<TournamentLock>("tournament", millisToRun, threadCounts, csLengths, ncsLength, useTryLock); ranAny = true; }
+    if (all || !strcmp(alg, "cohort"))     { sweep<CohortLock>("cohort", millisToRun, threadCounts, csLengths, ncsLength, useTryLock); ranAny = true; }
+    binding_deinit();
+
+    if (!ranAny) {
+        cout<<"Bad lock name: "<<alg<<endl;
+        return 1;
+    }
+    return 0;
+}
@@ -14,6 +14,9 @@
 #include "tree_prealloc_internal.h"         // Version B
 #include "bronson_pext_bst_occ/adapter.h"   // competitor's tree
 #include "binding.h"
+#include "locks.h"
+#include "cohort_lock.h"
+#include "bravo_lock.h"
 
 using namespace std;
 
@@ -27,9 +30,9 @@ struct globals_t {
     volatile char padding3[PADDING_BYTES];
     volatile bool done;
     volatile char padding4[PADDING_BYTES];
-    volatile bool start;        // used for a custom barrier implementation (should threads start yet?)
+    ParkingWord start;          // used for a custom barrier implementation (should threads start yet?)
     volatile char padding5[PADDING_BYTES];
-    atomic_int running;         // used for a custom barrier implementation (how many threads are waiting?)
+    ParkingWord running;        // used for a custom barrier implementation (how many threads are waiting?)
     volatile char padding6[PADDING_BYTES];
     DataStructureType * ds;
     debugCounter numTotalOps;   // already has padding built in at the beginning and end
@@ -47,8 +50,6 @@ struct globals_t {
             rngs[i].setSeed(i+1); // +1 because we don't want thread 0 to get a seed of 0, since seeds of 0 usually mean all random numbers are zero...
         }
         done = false;
-        start = false;
-        running = 0;
         ds = _ds;
         millisToRun = _millisToRun;
         totalThreads = _totalThreads;
@@ -62,7 +63,7 @@ struct globals_t {
 
 void runTrial(auto g, const long millisToRun, double insertPercent, double deletePercent) {
     g->done = false;
-    g->start = false;
+    g->start.store(0);
 
     // create and start threads
     thread * threads[MAX_THREADS]; // just allocate an array for max threads to avoid changing data layout (which can affect results) when varying thread count. the small amount of wasted space is not a big deal.
@@ -74,7 +75,7 @@ void runTrial(auto g, const long millisToRun, double insertPercent, double delet
 
             // BARRIER WAIT
             g->running.fetch_add(1);
-            while (!g->start) { TRACE TPRINT("waiting to start"<<endl); }               // wait to start
+            g->start.waitUntil([](int v) { return v; });                                 // wait to start (spin, then park)
 
             int key = 0;
             for (int cnt=0; !g->done; ++cnt) {
@@ -115,12 +116,9 @@ void runTrial(auto g, const long millisToRun, double insertPercent, double delet
         });
     }
 
-    while (g->running < g->totalThreads) {
-        TRACE cout<<"main thread: waiting for threads to START running="<<g->running<<endl;
-    }
+    g->running.waitUntil([&](int v) { return v >= g->totalThreads; }); // wait for all threads to be ready
     g->timer.startTimer();
-    __sync_synchronize(); // prevent compiler from reordering "start = true;" before the timer start; this is mostly paranoia, since start is volatile, and nothing should be reordered around volatile reads/writes
-    g->start = true; // release all threads from the barrier, so they can work
+    g->start.store(1); // release all threads from the barrier, so they can work (seq_cst store, and it wakes any parked threads)
 
     // sleep the main thread for length of time the trial should run
     timespec ts;
@@ -128,7 +126,7 @@ void runTrial(auto g, const long millisToRun, double insertPercent, double delet
     ts.tv_nsec = 1000000 * (millisToRun % 1000);
     nanosleep(&ts, NULL);
 
-    while (g->running > 0) { std::this_thread::yield(); /* wait for all threads to stop working */ }
+    g->running.waitUntil([](int v) { return v <= 0; }); // wait for all threads to stop working
 
 
     // join all threads
@@ -227,17 +225,43 @@ void runExperiment(int keyRangeSize, int millisToRun, int totalThreads, double i
     delete g;
 }
 
+// run one of our TLE trees with the fallback lock named by lockName
+template <template <class> class TreeType>
+bool runWithFallbackLock(const char * lockName, int keyRangeSize, int millisToRun, int totalThreads, double insertPercent, double deletePercent) {
+    if (strcmp(lockName, "tas") == 0) {
+        runExperiment<TreeType<TryLock>>(keyRangeSize, millisToRun, totalThreads, insertPercent, deletePercent);
+    } else if (strcmp(lockName, "ticket") == 0) {
+        runExperiment<TreeType<TicketLock>>(keyRangeSize, millisToRun, totalThreads, insertPercent, deletePercent);
+    } else if (strcmp(lockName, "mcs") == 0) {
+        runExperiment<TreeType<MCSLock>>(keyRangeSize, millisToRun, totalThreads, insertPercent, deletePercent);
+    } else if (strcmp(lockName, "clh") == 0) {
+        runExperiment<TreeType<CLHLock>>(keyRangeSize, millisToRun, totalThreads, insertPercent, deletePercent);
+    } else if (strcmp(lockName, "cohort") == 0) {
+        runExperiment<TreeType<CohortLock>>(keyRangeSize, millisToRun, totalThreads, insertPercent, deletePercent);
+    } else if (strcmp(lockName, "bravo") == 0) {
+        runExperiment<TreeType<BRAVOLock>>(keyRangeSize, millisToRun, totalThreads, insertPercent, deletePercent);
+    } else {
+        cout<<"Bad fallback lock name: "<<lockName<<endl;
+        return false;
+    }
+    return true;
+}
+
 int main(int argc, char** argv) {
     if (argc == 1) {
         cout<<"USAGE: "<<argv[0]<<" [options]"<<endl;
         cout<<"Options:"<<endl;
-        cout<<"    -a [string]     tree algorithm to run ('yours' or 'occ' [default 'yours'])"<<endl;
+        cout<<"    -a [string]     tree algorithm to run ('yours', 'b' or 'occ' [default 'yours'])"<<endl;
+        cout<<"    -l [string]     fallback lock for 'yours' and 'b' in { tas, ticket, mcs, clh, cohort, bravo } [default 'tas']"<<endl;
+        cout<<"                    (bravo is a reader-writer lock: contains() on the fallback path runs concurrently)"<<endl;
         cout<<"    -t [int]        milliseconds to run"<<endl;
         cout<<"    -s [int]        size of the key range that random keys will be drawn from (i.e., range [1, s])"<<endl;
         cout<<"    -n [int]        number of threads that will perform inserts/deletes/searches"<<endl;
         cout<<"    -i [double]     percent of operations that will be insert (example: 20)"<<endl;
         cout<<"    -d [double]     percent of operations that will be delete (example: 20)"<<endl;
         cout<<"                    (100 - i - d)% of operations will be contains"<<endl;
+        cout<<"    -os [int]       oversubscribe: run [int] threads per online logical processor (overrides -n)"<<endl;
+        cout<<"    -spin           never park waiting threads (pure spinning), to compare against spin-then-park"<<endl;
         cout<<"    -pin [pattern]  pin threads to logical processors according to [pattern], e.g., -pin 0-23,48-71,24-47,72-95"<<endl;
         cout<<"                    (this will pin the first thread to CPU 0, next thread to CPU 1, and so on, then the 24th thread to CPU 48, and so on)"<<endl;
         cout<<endl;
@@ -251,7 +275,9 @@ int main(int argc, char** argv) {
     int totalThreads = 0;
     double insertPercent = 0;
     double deletePercent = 0;
+    int oversubscription = 0;
     char * alg = NULL;
+    const char * fallbackLock = "tas";
 
     // read command line args
     for (int i=1;i<argc;++i) {
@@ -267,6 +293,12 @@ int main(int argc, char** argv) {
             deletePercent = atof(argv[++i]);
         } else if (strcmp(argv[i], "-a") == 0) {
             alg = argv[++i];
+        } else if (strcmp(argv[i], "-l") == 0) {
+            fallbackLock = argv[++i];
+        } else if (strcmp(argv[i], "-os") == 0) {
+            oversubscription = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-spin") == 0) {
+            spinParkEnabled = false;
         } else if (strcmp(argv[i], "-pin") == 0) { // e.g., "-pin 1,2,3,8-11,4-7,0"
             binding_parseCustom(argv[++i]);
             std::cout<<"parsed custom binding: "<<argv[i]<<std::endl;
@@ -276,6 +308,10 @@ int main(int argc, char** argv) {
         }
     }
 
+    if (oversubscription > 0) {
+        totalThreads = oversubscription * sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
     // print command and args for debugging
     std::cout<<"Cmd:";
     for (int i=0;i<argc;++i) {
@@ -290,6 +326,8 @@ int main(int argc, char** argv) {
     PRINT(insertPercent);
     PRINT(deletePercent);
     PRINT(millisToRun);
+    PRINT(fallbackLock);
+    PRINT(spinParkEnabled);
     cout<<endl;
 
     // check for too large thread count
@@ -301,9 +339,9 @@ int main(int argc, char** argv) {
     // configure thread pinning/binding (according to command line args)
     binding_configurePolicy(totalThreads);
     if (alg == NULL || strcmp(alg, "yours") == 0) {
-        runExperiment<ExternalBST>(keyRangeSize, millisToRun, totalThreads, insertPercent, deletePercent);
+        if (!runWithFallbackLock<ExternalBST>(fallbackLock, keyRangeSize, millisToRun, totalThreads, insertPercent, deletePercent)) return 1;
     } else if (strcmp(alg, "b") == 0){
-        runExperiment<ExternalBSTB>(keyRangeSize, millisToRun, totalThreads, insertPercent, deletePercent);
+        if (!runWithFallbackLock<ExternalBSTB>(fallbackLock, keyRangeSize, millisToRun, totalThreads, insertPercent, deletePercent)) return 1;
     } else {
         runExperiment< OCCBST<int, int *> >(keyRangeSize, millisToRun, totalThreads, insertPercent, deletePercent);
     }
@@ -6,6 +6,7 @@
 //Use this for your maximum number of retries for your fast path
 #define MAX_RETRIES 40
 
+template <class FallbackLock = TryLock>
 class ExternalBSTB {
 private:
     struct Node {
@@ -37,12 +38,32 @@ private:
     Node * root;
     volatile char padding2[PADDING_BYTES];
 
-    // suggestion: place your lock to be used for TLE here (see util.h for a lock implementation)
+    // suggestion: place your lock to be used for TLE here (TryLock in util.h by default; see locks.h, cohort_lock.h and bravo_lock.h for alternatives)
     // be sure to add padding as appropriate! you REALLY want to ensure there's NO false sharing on your lock.
-    TryLock bstLock;
+    FallbackLock bstLock;
 
     volatile char padding3[PADDING_BYTES];
 
+    // bumped after every release of bstLock, so threads waiting for the fallback path to finish can sleep until it does
+    ParkingWord fallbackReleases;
+
+    volatile char padding4[PADDING_BYTES];
+
+    // if the fallback lock is a reader-writer lock (e.g., BRAVOLock in bravo_lock.h),
+    // contains() takes it in read mode, so searches on the fallback path run concurrently
+    static constexpr bool readerWriterFallback = requires (FallbackLock & l) { l.readLock(0); l.readUnlock(0); };
+
+    // transactions (and fallback paths) that only read must wait for writers only
+    bool writerActive() {
+        if constexpr (readerWriterFallback) return bstLock.isWriteHeld();
+        else return bstLock.isHeld();
+    }
+    // transactions that write must not run while readers could be in the visible readers table
+    bool readerBiased() {
+        if constexpr (readerWriterFallback) return bstLock.isReaderBiased();
+        else return false;
+    }
+
 public:
     ExternalBSTB(const int _numThreads, const int _minKey, const int _maxKey);
     ~ExternalBSTB();
@@ -69,82 +90,92 @@ private:
     long getSumOfKeysInSubtree(Node * node);
 };
 
-ExternalBSTB::ExternalBSTB(const int _numThreads, const int _minKey, const int _maxKey)
+template <class FallbackLock>
+ExternalBSTB<FallbackLock>::ExternalBSTB(const int _numThreads, const int _minKey, const int _maxKey)
 : numThreads(_numThreads), minKey(_minKey), maxKey(_maxKey) {
     Node * rootLeft = createLeaf(minKey - 1);
     Node * rootRight = createLeaf(maxKey + 1);
     root = createInternal(minKey - 1, rootLeft, rootRight);
 }
-ExternalBSTB::~ExternalBSTB() {
+template <class FallbackLock>
+ExternalBSTB<FallbackLock>::~ExternalBSTB() {
     freeSubtree(root);
 }
 
-bool ExternalBSTB::contains(const int tid, const int & key) {
+template <class FallbackLock>
+bool ExternalBSTB<FallbackLock>::contains(const int tid, const int & key) {
     int retriesRemaining = MAX_RETRIES;
     bool result;
 retry:
     if (_xbegin() == _XBEGIN_STARTED){
-        if (bstLock.isHeld()) {_xabort(_XABORT_RETRY | _XABORT_CONFLICT);}
+        if (writerActive()) {_xabort(_XABORT_RETRY | _XABORT_CONFLICT);}
         result = sequentialContains(tid, key);
         _xend();
         return result;
     } else {
-        while (bstLock.isHeld()) {
-            // TODO sleep?
-        }
+        fallbackReleases.waitWhile([this]() { return writerActive(); }); // spin, then sleep until the fallback path releases the lock
         if (--retriesRemaining > 0) { goto retry; }
-        bstLock.acquire();
-        result = sequentialContains(tid, key);
-        bstLock.release();
+        if constexpr (readerWriterFallback) {
+            bstLock.readLock(tid);
+            result = sequentialContains(tid, key);
+            // only a reader that used the lock word can have kept isHeld() true, so only it must wake the waiters
+            if (bstLock.readUnlock(tid)) fallbackReleases.fetch_add(1);
+        } else {
+            bstLock.lock(tid);
+            result = sequentialContains(tid, key);
+            bstLock.unlock(tid);
+            fallbackReleases.fetch_add(1);
+        }
         return result;
     }
 }
 
-bool ExternalBSTB::insertIfAbsent(const int tid, const int & key) {
+template <class FallbackLock>
+bool ExternalBSTB<FallbackLock>::insertIfAbsent(const int tid, const int & key) {
     int retriesRemaining = MAX_RETRIES;
     bool result;
     Node * leaf = createInternal(key, NULL, NULL);
     Node * internal = createInternal(key, NULL, NULL); // dummy values
 retry:
     if (_xbegin() == _XBEGIN_STARTED){
-        if (bstLock.isHeld()) {_xabort(_XABORT_RETRY | _XABORT_CONFLICT);}
+        if (bstLock.isHeld() || readerBiased()) {_xabort(_XABORT_RETRY | _XABORT_CONFLICT);}
         result = sequentialInsertIfAbsent(tid, key, leaf, internal);
         _xend();
         return result;
     } else {
-        while (bstLock.isHeld()) {
-            // TODO sleep?
-        }
-        if (--retriesRemaining > 0) { goto retry; }
-        bstLock.acquire();
+        fallbackReleases.waitWhile([this]() { return bstLock.isHeld(); }); // spin, then sleep until the fallback path releases the lock
+        if (--retriesRemaining > 0 && !readerBiased()) { goto retry; } // only taking the lock revokes reader bias
+        bstLock.lock(tid);
         result = sequentialInsertIfAbsent(tid, key, leaf, internal);
-        bstLock.release();
+        bstLock.unlock(tid);
+        fallbackReleases.fetch_add(1);
         return result;
     }
 }
 
-bool ExternalBSTB::erase(const int tid, const int & key) {
+template <class FallbackLock>
+bool ExternalBSTB<FallbackLock>::erase(const int tid, const int & key) {
     int retriesRemaining = MAX_RETRIES;
     bool result;
 retry:
     if (_xbegin() == _XBEGIN_STARTED){
-        if (bstLock.isHeld()) {_xabort(_XABORT_RETRY | _XABORT_CONFLICT);}
+        if (bstLock.isHeld() || readerBiased()) {_xabort(_XABORT_RETRY | _XABORT_CONFLICT);}
         result = sequentialErase(tid, key);
         _xend();
         return result;
     } else {
-        while (bstLock.isHeld()) {
-            // TODO sleep?
-        }
-        if (--retriesRemaining > 0) { goto retry; }
-        bstLock.acquire();
+        fallbackReleases.waitWhile([this]() { return bstLock.isHeld(); }); // spin, then sleep until the fallback path releases the lock
+        if (--retriesRemaining > 0 && !readerBiased()) { goto retry; } // only taking the lock revokes reader bias
+        bstLock.lock(tid);
         result = sequentialErase(tid, key);
-        bstLock.release();
+        bstLock.unlock(tid);
+        fallbackReleases.fetch_add(1);
         return result;
     }
 }
 
-ExternalBSTB::SearchRecord ExternalBSTB::search(const int tid, const int & key) {
+template <class FallbackLock>
+typename ExternalBSTB<FallbackLock>::SearchRecord ExternalBSTB<FallbackLock>::search(const int tid, const int & key) {
     Node * gp;
     Node * p = NULL;
     Node * n = root;
@@ -156,13 +187,15 @@ ExternalBSTB::SearchRecord ExternalBSTB::search(const int tid, const int & key)
     return SearchRecord(gp, p, n);
 }
 
-bool ExternalBSTB::sequentialContains(const int tid, const int & key) {
+template <class FallbackLock>
+bool ExternalBSTB<FallbackLock>::sequentialContains(const int tid, const int & key) {
     assert(key >= minKey && key <= maxKey);
     SearchRecord rec = search(tid, key);
     return (rec.n->key == key);
 }
 
-bool ExternalBSTB::sequentialInsertIfAbsent(const int tid, const int & key, Node * newLeaf, Node * newInternal) {
+template <class FallbackLock>
+bool ExternalBSTB<FallbackLock>::sequentialInsertIfAbsent(const int tid, const int & key, Node * newLeaf, Node * newInternal) {
     assert(key >= minKey && key <= maxKey);
     SearchRecord ret = search(tid, key);
     
@@ -192,7 +225,8 @@ bool ExternalBSTB::sequentialInsertIfAbsent(const int tid, const int & key, Node
     return true;
 }
 
-bool ExternalBSTB::sequentialErase(const int tid, const int & key) {
+template <class FallbackLock>
+bool ExternalBSTB<FallbackLock>::sequentialErase(const int tid, const int & key) {
     assert(key >= minKey && key <= maxKey);
     SearchRecord ret = search(tid, key);
     if (key != ret.n->key) return false;
@@ -210,24 +244,28 @@ bool ExternalBSTB::sequentialErase(const int tid, const int & key) {
     return true;
 }
 
-ExternalBSTB::Node * ExternalBSTB::createInternal(int key, Node * left, Node * right) {
+template <class FallbackLock>
+typename ExternalBSTB<FallbackLock>::Node * ExternalBSTB<FallbackLock>::createInternal(int key, Node * left, Node * right) {
     Node * node = new Node();
     node->key = key;
     node->left = left;
     node->right = right;
     return node;
 }
-ExternalBSTB::Node * ExternalBSTB::createLeaf(int key) {
+template <class FallbackLock>
+typename ExternalBSTB<FallbackLock>::Node * ExternalBSTB<FallbackLock>::createLeaf(int key) {
     return createInternal(key, NULL, NULL);
 }
-void ExternalBSTB::freeSubtree(Node * node) {
+template <class FallbackLock>
+void ExternalBSTB<FallbackLock>::freeSubtree(Node * node) {
     if (node == NULL) return;
     freeSubtree(node->left);
     freeSubtree(node->right);
     delete node;
 }
 
-long ExternalBSTB::getSumOfKeysInSubtree(Node * node) {
+template <class FallbackLock>
+long ExternalBSTB<FallbackLock>::getSumOfKeysInSubtree(Node * node) {
     if (node == NULL) return 0;
     // only leaves contain real keys
     if (node->isLeaf()) {
@@ -243,9 +281,11 @@ long ExternalBSTB::getSumOfKeysInSubtree(Node * node) {
              + getSumOfKeysInSubtree(node->right);
     }
 }
-long ExternalBSTB::getSumOfKeys() {
+template <class FallbackLock>
+long ExternalBSTB<FallbackLock>::getSumOfKeys() {
     return getSumOfKeysInSubtree(root);
 }
-void ExternalBSTB::printDebuggingDetails() {
+template <class FallbackLock>
+void ExternalBSTB<FallbackLock>::printDebuggingDetails() {
 }
 